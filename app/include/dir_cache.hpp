@@ -0,0 +1,51 @@
+#pragma once
+
+#include <switch.h>
+#include <vector>
+#include <string>
+#include "fs.hpp"
+
+namespace sphaira {
+
+struct DirCacheEntry {
+    std::string name{};
+    s8 type{};
+    s64 file_size{};
+    FsTimeStampRaw time_stamp{};
+    // name of the first file in a zip.
+    std::string internal_name{};
+    // set once the zip was opened, even if it had no file.
+    bool checked_internal{};
+};
+
+// listing of a directory stored on the sd card, along with the metadata the
+// file browser looked up for each entry, so that a directory that has not
+// changed can be listed without reading it again.
+// the listing is only valid whilst the mtime and the number of entries of the
+// directory match, fat does not always update the mtime when a file is added.
+// neither changes when a file is overwritten in place, so the file browser
+// still checks the size and timestamp of each file once its row is shown.
+struct DirCache {
+    static constexpr inline const char* PATH = "/switch/TotalSMS/cache/dirs/";
+
+    // returns the path of the cache for the directory.
+    static auto GetCachePath(const fs::FsPath& dir_path) -> fs::FsPath;
+    // returns 0 if the mtime could not be read, the directory should not be cached.
+    static auto GetDirMtime(fs::Fs* fs, const fs::FsPath& dir_path) -> u64;
+    // returns -1 if the directory could not be read, the directory should not be cached.
+    static auto GetDirCount(fs::Fs* fs, const fs::FsPath& dir_path) -> s64;
+
+    // fails if the file does not exist, is invalid or is of another directory.
+    Result Load(const fs::FsPath& dir_path);
+    Result Save() const;
+    // returns the file contents, for writing on another thread.
+    auto Serialize() const -> std::vector<u8>;
+
+    fs::FsPath path{};
+    u64 mtime{};
+    // entries in the directory, including the ones that are not listed.
+    s64 count{};
+    std::vector<DirCacheEntry> entries{};
+};
+
+} // namespace sphaira
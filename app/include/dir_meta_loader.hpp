@@ -0,0 +1,89 @@
+#pragma once
+
+#include <switch.h>
+#include <vector>
+#include <string>
+#include "fs.hpp"
+
+namespace sphaira {
+
+struct DirMetaRequest {
+    // index of the entry, returned with the result.
+    u32 index{};
+    bool is_dir{};
+    fs::FsPath path{};
+    // only used for files.
+    bool load_time_stamp{};
+    // opens the zip to find the name of the file inside.
+    bool load_internal{};
+    // also reads the size with the timestamp, for entries from the dir cache.
+    bool load_size{};
+};
+
+struct DirMetaResult {
+    u32 index{};
+    bool is_dir{};
+    // only set for folders, -1 if they could not be counted.
+    s64 file_count{-1};
+    s64 dir_count{-1};
+    // only set for files.
+    FsTimeStampRaw time_stamp{};
+    s64 file_size{-1};
+    // set if load_internal was requested, even if the zip had no file.
+    bool checked_internal{};
+    // name of the first file in the zip, empty if there is none.
+    std::string internal_name{};
+};
+
+// looks up the file and folder count of folders, the timestamp and size of
+// files and the name of the file inside zips on a thread, so that the file
+// browser does no io whilst drawing or scrolling.
+// only the entries that were last requested are loaded, in the order given.
+struct DirMetaLoader {
+    DirMetaLoader() = default;
+    ~DirMetaLoader();
+
+    Result Init();
+    void Exit();
+
+    // drops all requests and results, call this when the listing changes.
+    // fs must stay valid until the next Reset() or Exit().
+    void Reset(fs::Fs* fs);
+
+    // replaces the requests that have not been loaded yet.
+    void Request(std::vector<DirMetaRequest>&& requests);
+
+    // moves the results loaded since the last call into out.
+    void Poll(std::vector<DirMetaResult>& out);
+
+    auto IsRunning() const -> bool {
+        return m_running;
+    }
+
+    // loads a single request, used by the thread.
+    static auto Load(fs::Fs* fs, const DirMetaRequest& request) -> DirMetaResult;
+
+private:
+    static void ThreadFunc(void* arg);
+    void ThreadLoop();
+
+private:
+    Thread m_thread{};
+    Mutex m_mutex{};
+    CondVar m_can_work{};
+
+    // shared data start.
+    fs::Fs* m_fs{};
+    // bumped by Reset(), results of older requests are dropped.
+    u64 m_generation{};
+    std::vector<DirMetaRequest> m_requests{};
+    // index of the next request to load.
+    size_t m_next{};
+    std::vector<DirMetaResult> m_results{};
+    bool m_quit{};
+    // shared data end.
+
+    bool m_running{};
+};
+
+} // namespace sphaira
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <switch.h>
+#include <vector>
+#include "fs.hpp"
+#include "dir_cache.hpp"
+
+namespace sphaira {
+
+struct DirScanResult {
+    Result rc{};
+    // mtime of the directory, 0 if it should not be cached.
+    u64 mtime{};
+    // entries in the directory, see DirCache::count.
+    s64 count{};
+    // set if the entries were loaded from the cache.
+    bool cached{};
+};
+
+// reads a directory on a thread in chunks, so that the entries can be shown
+// whilst the rest of the directory is still being read.
+// starting a new scan cancels the one in progress.
+// if the directory is unchanged since it was cached, the cached listing is used.
+// see DirCache for how a change is detected.
+struct DirScanner {
+    DirScanner() = default;
+    ~DirScanner();
+
+    Result Init();
+    void Exit();
+
+    // fs must stay valid until the scan is finished or cancelled.
+    // use_cache loads the listing from the cache if it is still valid.
+    void Start(fs::Fs* fs, const fs::FsPath& path, bool use_cache);
+    // stops the scan, entries that were not polled are dropped.
+    void Cancel();
+
+    // moves the entries read since the last call into out.
+    // returns true once every entry has been polled, result is then set.
+    auto Poll(std::vector<DirCacheEntry>& out, DirScanResult& result) -> bool;
+
+    // writes the cache on the thread, pending writes are finished by Exit().
+    void Save(DirCache&& cache);
+
+    // true between Start() and the final Poll().
+    auto IsScanning() const -> bool {
+        return m_scanning;
+    }
+
+    auto IsRunning() const -> bool {
+        return m_running;
+    }
+
+private:
+    static void ThreadFunc(void* arg);
+    void ThreadLoop();
+    Result ScanDir(fs::Fs* fs, const fs::FsPath& path, bool use_cache, u64 generation, u64& mtime, s64& count, bool& cached);
+
+private:
+    Thread m_thread{};
+    Mutex m_mutex{};
+    CondVar m_can_work{};
+
+    // shared data start.
+    fs::Fs* m_fs{};
+    fs::FsPath m_path{};
+    bool m_use_cache{};
+    // bumped by every Start() and Cancel(), chunks of older scans are dropped.
+    u64 m_generation{};
+    bool m_pending{};
+    bool m_done{};
+    DirScanResult m_result{};
+    std::vector<DirCacheEntry> m_entries{};
+    std::vector<DirCache> m_saves{};
+    bool m_quit{};
+    // shared data end.
+
+    bool m_scanning{};
+    bool m_running{};
+};
+
+} // namespace sphaira
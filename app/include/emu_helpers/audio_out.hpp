@@ -0,0 +1,94 @@
+#pragma once
+
+#include <switch.h>
+#include "ui/types.hpp"
+#include "emu_helpers/audio_sink.hpp"
+
+namespace sphaira {
+
+// queues blocks of stereo s16 samples to audout.
+// the number of blocks allowed in the queue starts at the latency target,
+// grows when audout runs dry and shrinks again once playback has been
+// stable for a while, so latency stays as low as the current game allows.
+struct AudioOut final : AudioSink {
+    static constexpr u32 MAX_BUFFERS = 16;
+
+    AudioOut() = default;
+    ~AudioOut();
+
+    // max_block_size is the most samples that will ever be pushed at once.
+    Result Init(u32 sample_rate, u32 max_block_size);
+    void Exit();
+
+    void Start() override;
+    void Stop() override;
+    void Flush() override;
+    void Configure(u32 block_size, u32 latency_ms) override;
+    auto Acquire() -> s16* override;
+    bool Submit(const s16* samples, u32 size) override;
+    void Release(const s16* buffer) override;
+    auto GetFreeCount() -> u32 override;
+    auto GetStats() const -> AudioSinkStats override;
+    void ResetStats() override;
+
+    auto GetMaxQueued() const -> u32 {
+        return m_max_queued;
+    }
+
+    auto IsRunning() const -> bool {
+        return m_running;
+    }
+
+private:
+    enum BufferState {
+        BufferState_Free,
+        // acquired, being written by the caller.
+        BufferState_Owned,
+        // appended to audout.
+        BufferState_Queued,
+    };
+
+    void PollReleased();
+    auto FindBuffer(const s16* samples) const -> s32;
+    auto FindFree() const -> s32;
+    auto GetQueuedCount() const -> u32;
+    void Adapt(u32 queued);
+
+private:
+    AudioOutBuffer m_buffers[MAX_BUFFERS]{};
+    BufferState m_state[MAX_BUFFERS]{};
+    void* m_memory{};
+    size_t m_stride{};
+
+    u32 m_sample_rate{};
+    u32 m_max_block_size{};
+    u32 m_block_size{};
+    // blocks needed to reach the latency target.
+    u32 m_target_queued{};
+    // blocks allowed in the queue, never less than the target.
+    u32 m_max_queued{};
+
+    // tick that each queued buffer was submitted.
+    u64 m_submit_tick[MAX_BUFFERS]{};
+
+    // stats.
+    u32 m_underruns{};
+    u32 m_overruns{};
+    u32 m_submitted{};
+    u32 m_queue_depth{};
+    u32 m_queue_depth_max{};
+    u64 m_queue_depth_total{};
+    u64 m_latency_ns{};
+    u64 m_latency_max_ns{};
+    u64 m_latency_total_ns{};
+    u32 m_latency_count{};
+    // reset on underrun, the queue shrinks when this gets old.
+    TimeStamp m_stable_ts{};
+    // set once a block is queued, cleared on flush, so the first push isn't an underrun.
+    bool m_playing{};
+    // set after a flush, audout may not report flushed buffers as released.
+    bool m_resync{};
+    bool m_running{};
+};
+
+} // namespace sphaira
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace sphaira {
+
+struct AudioSinkStats {
+    // times the output ran out of audio whilst playing.
+    uint32_t underruns;
+    // blocks dropped because the queue was full.
+    uint32_t dropped;
+    uint32_t submitted;
+    // number of blocks queued when a block was submitted.
+    uint32_t queue_depth;
+    uint32_t queue_depth_max;
+    double queue_depth_avg;
+    // current limit of the queue.
+    uint32_t max_queued;
+    // time from a block being submitted until it was played.
+    double latency_ms;
+    double latency_avg_ms;
+    double latency_max_ms;
+};
+
+// where the emulator sends its audio, blocks of stereo s16 samples.
+// only AudioOut depends on libnx, the other sinks build on any platform so
+// that the audio path can be run headless and its output compared.
+struct AudioSink {
+    virtual ~AudioSink() = default;
+
+    virtual void Start() = 0;
+    virtual void Stop() = 0;
+    // drops all queued audio.
+    virtual void Flush() = 0;
+
+    // block_size is the number of samples pushed at once.
+    // this flushes queued audio.
+    virtual void Configure(uint32_t block_size, uint32_t latency_ms) = 0;
+
+    // returns a buffer of max_block_size samples for the core to write into.
+    // it is owned by the caller until it is submitted or released.
+    // returns nullptr if every buffer is in use.
+    virtual auto Acquire() -> int16_t* = 0;
+    // queues a block. an acquired buffer is queued in place, anything else is
+    // copied. returns false if the block was dropped, an acquired buffer is
+    // then still owned by the caller.
+    virtual bool Submit(const int16_t* samples, uint32_t size) = 0;
+    // gives back an acquired buffer without queueing it.
+    virtual void Release(const int16_t* buffer) = 0;
+
+    // number of blocks that can be submitted before the queue is full.
+    virtual auto GetFreeCount() -> uint32_t = 0;
+
+    virtual auto GetStats() const -> AudioSinkStats = 0;
+    virtual void ResetStats() = 0;
+};
+
+// discards all audio, blocks are consumed as soon as they are submitted.
+struct AudioSinkNull : AudioSink {
+    AudioSinkNull(uint32_t sample_rate, uint32_t max_block_size);
+
+    void Start() override {}
+    void Stop() override {}
+    void Flush() override {}
+    void Configure(uint32_t block_size, uint32_t latency_ms) override;
+    auto Acquire() -> int16_t* override;
+    bool Submit(const int16_t* samples, uint32_t size) override;
+    void Release(const int16_t*) override {}
+    auto GetFreeCount() -> uint32_t override;
+    auto GetStats() const -> AudioSinkStats override;
+    void ResetStats() override;
+
+protected:
+    std::vector<int16_t> m_buffer;
+    uint32_t m_sample_rate{};
+    uint32_t m_max_queued{};
+    uint32_t m_submitted{};
+};
+
+// streams all audio to a 16-bit stereo wav file.
+// the header is written with a size of 0 and patched when the file is closed.
+// the file is closed once it reaches the 4GiB limit of the wav header.
+struct AudioSinkWav final : AudioSinkNull {
+    AudioSinkWav(uint32_t sample_rate, uint32_t max_block_size);
+    ~AudioSinkWav();
+
+    bool Open(const char* path);
+    void Close();
+
+    bool Submit(const int16_t* samples, uint32_t size) override;
+
+private:
+    void WriteHeader();
+
+private:
+    std::FILE* m_file{};
+    uint32_t m_data_size{};
+};
+
+} // namespace sphaira
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// decodes a 3 or 4 channel qoi image to rgba pixels, such as the thumbnail
+// written by qoi_encode_rgbx().
+// returns a malloc()'d buffer of w * h pixels, or NULL on error.
+uint32_t* qoi_decode_rgba(const void* data, size_t size, uint32_t* w, uint32_t* h);
+
+#ifdef __cplusplus
+}
+#endif
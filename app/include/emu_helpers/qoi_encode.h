@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// encodes rgba pixels as a 3 channel qoi image, alpha is ignored.
+// this is much faster than png and is done in a single pass, so there is
+// no need to convert the pixels to rgb first.
+// stride is the number of pixels per row of the input.
+// returns a malloc()'d buffer, or NULL on error.
+void* qoi_encode_rgbx(const uint32_t* pixels, uint32_t w, uint32_t h, uint32_t stride, size_t* out_size);
+
+#ifdef __cplusplus
+}
+#endif
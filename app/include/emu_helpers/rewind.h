@@ -2,38 +2,101 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 // these should return 0 on error.
-typedef size_t (*rewind_compressor_size)(size_t src_size);
-typedef size_t (*rewind_compressor)(const void* src_data, void* dst_data, size_t src_size, size_t dst_size, bool inflate_mode);
+typedef size_t (*rewind_compressor_size)(void* user, size_t src_size);
+typedef size_t (*rewind_compressor)(void* user, const void* src_data, void* dst_data, size_t src_size, size_t dst_size, bool inflate_mode);
 
 typedef struct Rewind Rewind;
 
+enum { REWIND_STATS_RATIO_BUCKETS = 10 };
+// latency percentiles are taken from this many of the most recent calls.
+enum { REWIND_STATS_LATENCY_SAMPLES = 128 };
+
+typedef struct RewindLatency
+{
+    uint64_t count; /* total number of calls. */
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+} RewindLatency;
+
+typedef struct RewindStats
+{
+    size_t count; /* frames in memory. */
+    size_t spill_count; /* frames in the spill. */
+    size_t compressed; /* bytes of frames in memory. */
+    size_t uncompressed;
+    // number of frames in memory in each 10% of compressed / uncompressed size.
+    size_t ratio_histogram[REWIND_STATS_RATIO_BUCKETS];
+    RewindLatency push; /* compress and push. */
+    RewindLatency pop;
+    RewindLatency get;
+} RewindStats;
+
+// optional second tier that frames are moved to once they fall out of memory.
+// spilled frames are always older than the frames in memory, so they come
+// first when indexing, index 0 being the oldest spilled frame.
+typedef struct RewindSpill
+{
+    void* user;
+    // takes ownership of data, even on failure.
+    bool (*push)(void* user, void* data, size_t compressed, size_t size, rewind_compressor compressor, void* compressor_user);
+    size_t (*get_count)(void* user);
+    bool (*get)(void* user, size_t index, void* data, size_t size);
+    bool (*get_size)(void* user, size_t index, size_t* compressed, size_t* uncompressed);
+    // removes index and everything after it.
+    bool (*remove_after)(void* user, size_t index);
+} RewindSpill;
+
 // set functions to NULL to not use compression.
-Rewind* rewind_init(size_t size, size_t frames_wanted, rewind_compressor compressor, rewind_compressor_size compressor_size);
+// user is passed to the compressor functions and must outlive all frames pushed with it.
+Rewind* rewind_init(size_t size, size_t frames_wanted, rewind_compressor compressor, rewind_compressor_size compressor_size, void* user);
 void rewind_close(Rewind* rw);
 void rewind_reset(Rewind* rw);
 
+// changes the compressor used for new frames, existing frames keep using the one they were pushed with.
+bool rewind_set_compressor(Rewind* rw, rewind_compressor compressor, rewind_compressor_size compressor_size, void* user);
+
+// frames that are overwritten are pushed to the spill rather than being freed.
+// set to NULL to disable, the spill must outlive the rewind.
+void rewind_set_spill(Rewind* rw, const RewindSpill* spill);
+// moves every frame in memory to the spill, oldest first.
+bool rewind_spill_all(Rewind* rw);
+
 // compressed can be NULL.
 bool rewind_push(Rewind* rw, const void* data, size_t size, size_t* compressed);
 bool rewind_pop(Rewind* rw, void* data, size_t size);
 bool rewind_get(Rewind* rw, size_t index, void* data, size_t size);
 
+// compresses data into a newly allocated buffer, to later be pushed with rewind_push_compressed().
+// this does not modify rw, so it can be called on a different thread to the one using rw.
+// returns NULL on error, the buffer must be free()'d if it is not pushed.
+void* rewind_compress(const Rewind* rw, const void* data, size_t size, size_t* compressed);
+// pushes data returned by rewind_compress(), rw takes ownership of the data, even on failure.
+bool rewind_push_compressed(Rewind* rw, void* compressed_data, size_t compressed, size_t size);
+// records the time taken to compress and push a frame when not using rewind_push().
+void rewind_add_push_time(Rewind* rw, uint64_t ns);
+
 // remove everything after index.
 bool rewind_remove_after(Rewind* rw, size_t index);
 
-// returns the number of frames.
+// returns the number of frames, including spilled frames.
 size_t rewind_get_count(const Rewind* rw);
 // returns the size of a frame.
 bool rewind_get_size(const Rewind* rw, size_t index, size_t* compressed, size_t* uncompressed);
 // returns the size of the last entry, same as rewind_get_size(rw, rewind_get_count(rw) - 1).
 bool rewind_get_size_last(const Rewind* rw, size_t* compressed, size_t* uncompressed);
-// returns the total size of all allocated memory.
+// returns the total size of all allocated memory, this does not include spilled frames.
 size_t rewind_get_allocated_size(const Rewind* rw, bool include_internal_buffers);
+// fills out stats, sizes are kept as running totals so this is cheap.
+void rewind_get_stats(const Rewind* rw, RewindStats* stats);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum RewindCodecType
+{
+    RewindCodecType_LZ4,
+    RewindCodecType_LZ4_FAST,
+    RewindCodecType_LZ4HC,
+    RewindCodecType_LZ4_DICT,
+    RewindCodecType_MAX,
+} RewindCodecType;
+
+// pass a pointer to this as the user data for the rewind compressor functions.
+typedef struct RewindCodec
+{
+    RewindCodecType type;
+    // acceleration for LZ4_FAST, compression level for LZ4HC.
+    int level;
+    // optional dictionary for LZ4_DICT, only the last 64KiB is used.
+    // this must not be changed whilst frames compressed with it exist.
+    const void* dict;
+    size_t dict_size;
+} RewindCodec;
+
+// fills out the codec with the default level for that type.
+void rewind_codec_init(RewindCodec* codec, RewindCodecType type);
+const char* rewind_codec_get_name(RewindCodecType type);
+
+// these match rewind_compressor_size and rewind_compressor, user is a RewindCodec.
+size_t rewind_codec_compressor_size(void* user, size_t src_size);
+size_t rewind_codec_compressor(void* user, const void* src_data, void* dst_data, size_t src_size, size_t dst_size, bool inflate_mode);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <switch.h>
+#include <vector>
+#include <span>
+#include "emu_helpers/rewind.h"
+#include "emu_helpers/rewind_codec.h"
+#include "fs.hpp"
+
+namespace sphaira {
+
+// stores frames that fall out of the in memory rewind in an append-only file.
+// frames are queued by the rewind and written on a low priority thread, an
+// index of file offsets is kept in memory so that any frame can be read back.
+struct RewindDisk {
+    RewindDisk() = default;
+    ~RewindDisk();
+
+    // frame_size is the uncompressed size of a single frame.
+    // codecs are used to decompress frames, indexed by RewindCodecType.
+    // if resume is set, frames from a previous session with the same frame_size
+    // and LZ4_DICT dictionary are kept.
+    Result Init(const fs::FsPath& path, size_t frame_size, s64 max_size, std::span<RewindCodec> codecs, bool resume);
+    // writes all pending frames then closes the thread.
+    // the file is deleted unless keep is set.
+    void Exit(bool keep);
+
+    // pass this to rewind_set_spill().
+    auto GetSpill() const -> const RewindSpill* {
+        return &m_spill;
+    }
+
+    auto IsRunning() const -> bool {
+        return m_running;
+    }
+
+private:
+    static void ThreadFunc(void* arg);
+    void ThreadLoop();
+    Result LoadIndex();
+    // removes index and everything after it, the lock must be held.
+    void RemoveAfter(size_t index);
+
+    static bool SpillPush(void* user, void* data, size_t compressed, size_t size, rewind_compressor compressor, void* compressor_user);
+    static size_t SpillGetCount(void* user);
+    static bool SpillGet(void* user, size_t index, void* data, size_t size);
+    static bool SpillGetSize(void* user, size_t index, size_t* compressed, size_t* uncompressed);
+    static bool SpillRemoveAfter(void* user, size_t index);
+
+private:
+    struct Entry {
+        // offset of the compressed data in the file.
+        s64 offset;
+        u32 compressed;
+        u32 codec;
+        // set until the writer has written the data to the file.
+        void* pending;
+    };
+
+    Thread m_thread{};
+    Mutex m_mutex{};
+    CondVar m_can_work{};
+
+    fs::FsNativeSd m_fs{};
+    fs::File m_file{};
+    fs::FsPath m_path{};
+    size_t m_frame_size{};
+    s64 m_max_size{};
+    std::span<RewindCodec> m_codecs{};
+    std::vector<u8> m_read_buf{};
+    RewindSpill m_spill{};
+
+    // shared data start.
+    std::vector<Entry> m_entries{};
+    // index of the first entry that has not been written.
+    size_t m_pending_index{};
+    // offset that the next entry will be written to.
+    s64 m_end_offset{};
+    // set whilst the entry at m_pending_index is written without the lock.
+    bool m_writing{};
+    // set if that entry was removed whilst it was written.
+    bool m_write_cancelled{};
+    // set if a write failed, no more frames are written.
+    bool m_failed{};
+    bool m_quit{};
+    // shared data end.
+
+    bool m_running{};
+};
+
+} // namespace sphaira
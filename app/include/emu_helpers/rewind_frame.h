@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// frames are stored in rewind as 8-bit indices followed by a palette.
+// the sms / gg only show 32 colours at once, so this is lossless for normal
+// games and is 4x smaller than rgba before compression.
+enum { REWIND_FRAME_PALETTE_COUNT = 256 };
+
+// returns the size needed to store an encoded frame.
+size_t rewind_frame_get_size(size_t width, size_t height);
+
+// dst must be rewind_frame_get_size() bytes.
+// if the frame has more than 256 colours, the extra colours use the closest palette entry.
+void rewind_frame_encode(void* dst, const uint32_t* pixels, size_t width, size_t height);
+// pixels must be width * height rgba pixels.
+void rewind_frame_decode(uint32_t* pixels, const void* src, size_t width, size_t height);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <switch.h>
+#include <vector>
+#include <span>
+#include "emu_helpers/rewind.h"
+#include "emu_helpers/rewind_codec.h"
+
+namespace sphaira {
+
+// compresses and pushes rewind frames on a low priority thread.
+// the caller copies a snapshot into a slot from Acquire(), then hands it back
+// with Submit(), so the main thread only pays for the copy.
+struct RewindWorker {
+    RewindWorker() = default;
+    ~RewindWorker();
+
+    // slot_size is the uncompressed size of a single frame.
+    Result Init(Rewind* rw, size_t slot_size);
+    // waits for all pending slots to be pushed, then closes the thread.
+    void Exit();
+
+    // returns a slot of slot_size bytes, blocks if all slots are pending.
+    // returns nullptr if the worker is not running.
+    auto Acquire() -> void*;
+    // queues the slot returned by Acquire() to be compressed and pushed.
+    void Submit();
+    // blocks until all pending slots have been pushed.
+    // this must be called before using the Rewind on another thread.
+    void Flush();
+    // returns the rewind stats without waiting for pending slots.
+    void GetStats(RewindStats* stats);
+
+    // compresses new frames with codec.
+    void SetCodec(RewindCodec* codec);
+    // measures every codec on the next few frames, then switches to the codec
+    // with the best ratio that fits within the time budget.
+    // the codecs must outlive the Rewind.
+    void SetAutoSelect(std::span<RewindCodec> codecs);
+
+    auto IsRunning() const -> bool {
+        return m_running;
+    }
+
+private:
+    static void ThreadFunc(void* arg);
+    void ThreadLoop();
+    void AutoSelectMeasure(const void* data);
+    void AutoSelectFinish();
+
+private:
+    // must be a power of 2.
+    static constexpr u32 SLOT_COUNT = 2;
+
+    Thread m_thread{};
+    Mutex m_mutex{};
+    CondVar m_can_work{};
+    CondVar m_can_submit{};
+
+    Rewind* m_rewind{};
+    std::vector<u8> m_slots[SLOT_COUNT]{};
+    size_t m_slot_size{};
+
+    struct CodecMeasurement {
+        u64 compressed{};
+        u64 push_ns{};
+        u64 pop_ns{};
+        bool failed{};
+    };
+
+    // auto select, only touched by the worker thread once set.
+    std::span<RewindCodec> m_auto_codecs{};
+    std::vector<CodecMeasurement> m_auto_results{};
+    std::vector<u8> m_auto_compress_buf{};
+    std::vector<u8> m_auto_decompress_buf{};
+    u32 m_auto_samples{};
+
+    // shared data start.
+    u32 m_r_index{};
+    u32 m_w_index{};
+    bool m_quit{};
+    // shared data end.
+
+    bool m_running{};
+};
+
+} // namespace sphaira
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <switch.h>
+#include <vector>
+#include <span>
+#include "fs.hpp"
+
+namespace sphaira {
+
+struct SaveStateSlot {
+    bool used{};
+    // seconds since epoch.
+    u64 timestamp{};
+    // rgba thumbnail, already decoded so it can be uploaded as is.
+    u16 thumbnail_w{};
+    u16 thumbnail_h{};
+    std::vector<u8> thumbnail{};
+};
+
+// small file stored next to the savestates with the timestamp and a
+// thumbnail of every slot, so that slots can be listed without opening
+// the savestates or decoding their png.
+struct SaveStateIndex {
+    static constexpr u32 USER_SLOT_COUNT = 10;
+    // used by auto save, these come after the user slots.
+    static constexpr u32 AUTO_SLOT_COUNT = 3;
+    static constexpr u32 SLOT_COUNT = USER_SLOT_COUNT + AUTO_SLOT_COUNT;
+    // thumbnails are the screen scaled down by this amount.
+    static constexpr u32 THUMBNAIL_SCALE = 4;
+    // savestate slots and the slot index are stored here.
+    static constexpr inline const char* PATH = "/switch/TotalSMS/states/";
+
+    // returns the name that files of the rom are stored under, the file name
+    // followed by a hash of the path, so roms with the same name in different
+    // folders do not share savestates.
+    static auto GetRomName(const fs::FsPath& rom_path) -> fs::FsPath;
+    // returns the path of the index for the rom.
+    static auto GetIndexPath(const fs::FsPath& rom_path) -> fs::FsPath;
+    // path of the index before the name included the hash.
+    static auto GetLegacyIndexPath(const fs::FsPath& rom_path) -> fs::FsPath;
+
+    // an empty index is used if the file does not exist or is invalid.
+    Result Load(const fs::FsPath& path);
+    Result Save() const;
+    // returns the file contents, for writing on another thread.
+    auto Serialize() const -> std::vector<u8>;
+
+    auto GetPath() const -> const fs::FsPath& {
+        return m_path;
+    }
+
+    auto Get(u32 slot) const -> const SaveStateSlot& {
+        return m_slots[slot];
+    }
+
+    // pixels is w * h rgba with a pitch of stride pixels.
+    void Set(u32 slot, u64 timestamp, const u32* pixels, u32 w, u32 h, u32 stride);
+    void Clear(u32 slot);
+
+    static auto IsAutoSlot(u32 slot) -> bool {
+        return slot >= USER_SLOT_COUNT;
+    }
+
+    // returns the auto slot that is unused or has the oldest savestate.
+    auto GetNextAutoSlot() const -> u32;
+
+private:
+    fs::FsPath m_path{};
+    SaveStateSlot m_slots[SLOT_COUNT]{};
+};
+
+} // namespace sphaira
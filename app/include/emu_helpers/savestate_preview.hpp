@@ -0,0 +1,73 @@
+#pragma once
+
+#include <switch.h>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "fs.hpp"
+
+namespace sphaira {
+
+struct SaveStatePreview {
+    // seconds since epoch.
+    u64 timestamp{};
+    // rgba thumbnail of the newest savestate.
+    u16 w{};
+    u16 h{};
+    std::vector<u8> thumbnail{};
+};
+
+// loads the newest savestate of a rom on a low priority thread so that the
+// file browser can show it without doing any file io or decoding in a frame.
+// entries are keyed by the rom path and the mtime of the savestate files,
+// they are only reloaded if a savestate was written since.
+struct SaveStatePreviewCache {
+    SaveStatePreviewCache() = default;
+    ~SaveStatePreviewCache();
+
+    Result Init();
+    void Exit();
+
+    // removes all entries, call this when the directory changes.
+    void Clear();
+    // checks the mtime of every entry again the next time it is requested.
+    void Invalidate();
+
+    // returns the preview if it is loaded, otherwise it is queued to be loaded.
+    // returns nullptr if the rom has no savestate.
+    auto Get(const fs::FsPath& rom_path) -> std::shared_ptr<const SaveStatePreview>;
+
+private:
+    static void ThreadFunc(void* arg);
+    void ThreadLoop();
+    void Load(const std::string& rom_path);
+
+private:
+    struct Entry {
+        // mtime of the savestate index and the savestate made by mgb.
+        u64 index_mtime{};
+        u64 legacy_mtime{};
+        bool loaded{};
+        bool stale{};
+        std::shared_ptr<const SaveStatePreview> preview{};
+    };
+
+    Thread m_thread{};
+    Mutex m_mutex{};
+    CondVar m_can_work{};
+
+    // only used by the thread.
+    fs::FsNativeSd m_fs{};
+
+    // shared data start.
+    std::unordered_map<std::string, Entry> m_entries{};
+    std::deque<std::string> m_queue{};
+    bool m_quit{};
+    // shared data end.
+
+    bool m_running{};
+};
+
+} // namespace sphaira
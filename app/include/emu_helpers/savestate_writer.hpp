@@ -0,0 +1,91 @@
+#pragma once
+
+#include <switch.h>
+#include <vector>
+#include <deque>
+#include <span>
+#include "fs.hpp"
+
+namespace sphaira {
+
+struct SaveStateJob {
+    // can be empty to only write the extra file.
+    fs::FsPath path{};
+    u64 timestamp{};
+    // output of SMS_savestate().
+    std::vector<u8> state{};
+    // rgba frame for the thumbnail.
+    std::vector<u32> pixels{};
+    u32 w{};
+    u32 h{};
+
+    // optional file written after the savestate, such as the slot index or sram.
+    fs::FsPath extra_path{};
+    std::vector<u8> extra{};
+};
+
+// writes savestates on a low priority thread so that the emulator does not
+// stall on encoding the thumbnail and writing to the sd card.
+// files are written to a temp file then renamed, so a savestate is never
+// left half written. use ReadFile() to read them, which falls back to the
+// temp or previous file if power was lost during the rename.
+struct SaveStateWriter {
+    SaveStateWriter() = default;
+    ~SaveStateWriter();
+
+    Result Init();
+    // writes all pending savestates then closes the thread.
+    void Exit();
+
+    void Push(SaveStateJob&& job);
+    // blocks until all pending savestates have been written.
+    void Flush();
+    // returns the number of writes that failed since the last call.
+    auto PopFailedCount() -> u32;
+
+    auto IsRunning() const -> bool {
+        return m_running;
+    }
+
+    // writes the job on the calling thread.
+    static Result Write(const SaveStateJob& job);
+    // writes a single file on the calling thread, the same way as a job.
+    static Result WriteFile(const fs::FsPath& path, std::span<const u8> data);
+    // reads a file written by the writer.
+    static Result ReadFile(const fs::FsPath& path, std::vector<u8>& out);
+
+private:
+    static void ThreadFunc(void* arg);
+    void ThreadLoop();
+    static Result WriteSaveState(fs::Fs* fs, const SaveStateJob& job);
+
+private:
+    Thread m_thread{};
+    Mutex m_mutex{};
+    CondVar m_can_work{};
+    CondVar m_done{};
+
+    // shared data start.
+    std::deque<SaveStateJob> m_jobs{};
+    bool m_busy{};
+    u32 m_failed{};
+    bool m_quit{};
+    // shared data end.
+
+    bool m_running{};
+};
+
+// header of savestates written by SaveStateWriter, followed by the state then the qoi thumbnail.
+// the thumbnail is only read to rebuild the SaveStateIndex if it is lost.
+struct SaveStateHeader {
+    static constexpr u32 MAGIC = 0x54535354; // TSST
+    static constexpr u32 VERSION = 0;
+
+    u32 magic;
+    u32 version;
+    u64 timestamp;
+    u32 state_size;
+    u32 thumbnail_size;
+};
+
+} // namespace sphaira
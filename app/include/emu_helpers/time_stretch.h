@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// changes the speed of stereo s16 audio without changing the pitch using wsola.
+// the input is cut into overlapping segments, each segment is placed at the
+// offset within a small window that best matches the end of the previous
+// segment, then cross-faded into it.
+typedef struct TimeStretch TimeStretch;
+
+// max_input is the most frames that will be pushed at once.
+TimeStretch* time_stretch_init(unsigned sample_rate, size_t max_input);
+void time_stretch_quit(TimeStretch* ts);
+
+// ratio is the speed of the input, 2.0 plays the input in half the time.
+void time_stretch_set_ratio(TimeStretch* ts, double ratio);
+// drops all buffered audio.
+void time_stretch_reset(TimeStretch* ts);
+
+// returns the number of frames buffered, frames that do not fit are dropped.
+size_t time_stretch_push(TimeStretch* ts, const int16_t* samples, size_t frames);
+// returns the number of frames written to samples, up to max_frames.
+size_t time_stretch_pull(TimeStretch* ts, int16_t* samples, size_t max_frames);
+
+#ifdef __cplusplus
+}
+#endif
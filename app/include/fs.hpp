@@ -215,6 +215,8 @@ struct Dir {
 };
 
 FsPath AppendPath(const fs::FsPath& root_path, const fs::FsPath& file_path);
+// fnv-1a of the path, for naming files that belong to a path.
+u64 HashPath(const char* path);
 
 Result CreateFile(FsFileSystem* fs, const FsPath& path, u64 size = 0, u32 option = 0, bool ignore_read_only = true);
 Result CreateDirectory(FsFileSystem* fs, const FsPath& path, bool ignore_read_only = true);
@@ -28,5 +28,8 @@ void FileFuncNative(zlib_filefunc64_def* funcs);
 // this version simply reads the local header + file name in 2 reads,
 // which takes 1-2ms.
 Result PeekFirstFileName(fs::Fs* fs, const fs::FsPath& path, fs::FsPath& name);
+// same as above, also returns the crc32 of the file from the local header.
+// crc32 is 0 if the zip stores it after the data instead.
+Result PeekFirstFile(fs::Fs* fs, const fs::FsPath& path, fs::FsPath& name, u32& crc32);
 
 } // namespace sphaira::mz
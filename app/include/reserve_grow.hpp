@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+namespace sphaira {
+
+// reserve() with the exact size stops a vector from growing geometrically,
+// so entries added in chunks would copy the whole vector every chunk.
+template <typename T>
+void ReserveGrow(std::vector<T>& v, size_t count) {
+    if (count > v.capacity()) {
+        v.reserve(std::max(count, v.capacity() * 2));
+    }
+}
+
+} // namespace sphaira
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <switch.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include "fs.hpp"
+
+namespace sphaira {
+
+enum RomSystem : u8 {
+    RomSystem_Unknown,
+    RomSystem_SMS,
+    RomSystem_GG,
+    RomSystem_SG,
+};
+
+struct RomLibraryEntry {
+    std::string path{};
+    s64 size{};
+    u64 mtime{};
+    // crc32 of the rom, for zips this is of the file inside, 0 if unknown.
+    u32 crc32{};
+    RomSystem system{};
+    // name of the first file in a zip.
+    std::string internal_name{};
+};
+
+using RomLibraryEntries = std::vector<RomLibraryEntry>;
+
+// index of every rom found under a set of folders, built on a low priority thread.
+// the index is stored on the sd card and loaded on start, a rescan only reads
+// roms whose size or mtime changed since they were indexed.
+struct RomLibrary {
+    static constexpr inline const char* PATH = "/switch/TotalSMS/library.bin";
+
+    RomLibrary() = default;
+    ~RomLibrary();
+
+    // loads the stored index on the thread.
+    Result Init();
+    void Exit();
+
+    // walks the folders on the thread, a scan in progress is restarted.
+    void Rescan(const std::vector<fs::FsPath>& roots);
+
+    // returns the entries of the last finished scan, sorted by path.
+    auto GetEntries() const -> std::shared_ptr<const RomLibraryEntries>;
+    // changes whenever the entries change.
+    auto GetGeneration() const -> u64;
+    auto IsScanning() const -> bool;
+
+private:
+    static void ThreadFunc(void* arg);
+    void ThreadLoop();
+    void Load();
+    Result Save(const RomLibraryEntries& entries);
+    // returns false if the scan was stopped.
+    bool Scan(const std::vector<fs::FsPath>& roots, RomLibraryEntries& out);
+    void IndexRom(const fs::FsPath& path, RomLibraryEntry& out);
+    bool ShouldStop();
+
+private:
+    Thread m_thread{};
+    mutable Mutex m_mutex{};
+    CondVar m_can_work{};
+
+    // only used by the thread.
+    fs::FsNativeSd m_fs{};
+    std::vector<u8> m_read_buf{};
+
+    // shared data start.
+    std::shared_ptr<const RomLibraryEntries> m_entries{};
+    u64 m_generation{};
+    std::vector<fs::FsPath> m_roots{};
+    bool m_pending{};
+    bool m_scanning{};
+    bool m_quit{};
+    // shared data end.
+
+    bool m_running{};
+};
+
+} // namespace sphaira
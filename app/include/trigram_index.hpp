@@ -0,0 +1,40 @@
+#pragma once
+
+#include <switch.h>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace sphaira {
+
+// maps every 3 character sequence of a name to the names that contain it, so
+// that a search only checks the names that contain all of the query's trigrams
+// rather than every name. matching is case insensitive.
+// names are added in chunks whilst a directory is scanned, so it is built incrementally.
+struct TrigramIndex {
+    void Clear();
+    void Reserve(size_t count);
+
+    // returns the id of the name, ids count up from 0.
+    auto Add(std::string_view name) -> u32;
+
+    // returns the ids of the names that contain query, in increasing order.
+    auto Search(std::string_view query) const -> std::vector<u32>;
+
+    auto GetCount() const -> size_t {
+        return m_offsets.size();
+    }
+
+private:
+    auto GetName(u32 id) const -> std::string_view;
+
+private:
+    // case folded names, each followed by a null.
+    std::string m_names{};
+    std::vector<u32> m_offsets{};
+    // ids are added in order, so each list is sorted.
+    std::unordered_map<u32, std::vector<u32>> m_postings{};
+};
+
+} // namespace sphaira
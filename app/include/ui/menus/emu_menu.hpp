@@ -7,9 +7,18 @@
 #include "fs.hpp"
 #include "option.hpp"
 #include <span>
+#include <memory>
 
 #include <sms.h>
 #include "emu_helpers/rewind.h"
+#include "emu_helpers/rewind_worker.hpp"
+#include "emu_helpers/rewind_disk.hpp"
+#include "emu_helpers/rewind_codec.h"
+#include "emu_helpers/rewind_frame.h"
+#include "emu_helpers/savestate_index.hpp"
+#include "emu_helpers/savestate_writer.hpp"
+#include "emu_helpers/time_stretch.h"
+#include "emu_helpers/audio_out.hpp"
 
 namespace sphaira::ui::menu::emu {
 
@@ -34,21 +43,52 @@ struct AudioSharedData {
 
 struct RewindBarTexture {
     int handle{};
-    bool used{};
+    // rewind index decoded into the texture, -1 if empty.
+    int index{-1};
+    // frame the texture was last drawn, used for lru eviction.
+    u64 last_used{};
 };
 
+// lru cache of decoded rewind entries, this is cleared whenever the bar is opened.
 struct RewindBarTextures {
-    RewindBarTexture textures[8]{};
+    // enough for every visible entry plus the prefetched neighbours.
+    RewindBarTexture textures[16]{};
+    // incremented every time the bar is drawn.
+    u64 frame{};
 
-    auto GetNext() -> const RewindBarTexture* {
+    auto Find(int index) -> RewindBarTexture* {
         for (auto& e : textures) {
-            if (!e.used) {
-                e.used = true;
+            if (e.index == index) {
                 return &e;
             }
         }
         return nullptr;
     }
+
+    // returns the least recently used texture, textures drawn this frame are never returned.
+    auto GetLru() -> RewindBarTexture* {
+        RewindBarTexture* lru{};
+        for (auto& e : textures) {
+            if (e.last_used == frame && e.index != -1) {
+                continue;
+            }
+
+            if (!lru || e.index == -1 || e.last_used < lru->last_used) {
+                lru = &e;
+                if (e.index == -1) {
+                    break;
+                }
+            }
+        }
+        return lru;
+    }
+
+    void Clear() {
+        for (auto& e : textures) {
+            e.index = -1;
+            e.last_used = 0;
+        }
+    }
 };
 
 enum EmuDisplayType {
@@ -79,6 +119,45 @@ enum EmuSystemType {
     EmuSystemType_SG1000,
 };
 
+enum EmuRewindCodecType {
+    EmuRewindCodecType_AUTO,
+    EmuRewindCodecType_LZ4,
+    EmuRewindCodecType_LZ4_FAST,
+    EmuRewindCodecType_LZ4HC,
+    EmuRewindCodecType_LZ4_DICT,
+};
+
+enum EmuAutoSaveType {
+    EmuAutoSaveType_OFF,
+    EmuAutoSaveType_30S,
+    EmuAutoSaveType_60S,
+    EmuAutoSaveType_120S,
+    EmuAutoSaveType_300S,
+};
+
+enum EmuSyncType {
+    // emulation is paced by the frame time, audio follows.
+    EmuSyncType_VIDEO,
+    // emulation is paced by audout releasing buffers, video follows.
+    EmuSyncType_AUDIO,
+};
+
+enum EmuAudioLatencyType {
+    EmuAudioLatencyType_32MS,
+    EmuAudioLatencyType_50MS,
+    EmuAudioLatencyType_100MS,
+    EmuAudioLatencyType_200MS,
+    EmuAudioLatencyType_400MS,
+};
+
+enum EmuAudioBackendType {
+    EmuAudioBackendType_AUDOUT,
+    // audio is discarded.
+    EmuAudioBackendType_NULL,
+    // audio is written to a wav file named after the rom.
+    EmuAudioBackendType_WAV,
+};
+
 enum EmuParType {
     EmuParType_AUTO,
     EmuParType_NONE,
@@ -100,6 +179,10 @@ struct Menu final : Widget {
         return true;
     }
 
+    auto GetRomPath() const -> const fs::FsPath& {
+        return m_rom_path;
+    }
+
     void emulator_update_texture_pixels(Menu* app, int handle, const void* pixel_buffer);
     bool rewind_push_new_frame(Menu* app);
 
@@ -134,9 +217,20 @@ public:
 
     option::OptionLong m_runahead{INI_SECTION, "runahead", 0};
     option::OptionBool m_runahead_lazy{INI_SECTION, "runahead_lazy", true};
+    option::OptionLong m_sync{INI_SECTION, "sync", EmuSyncType_VIDEO};
+    option::OptionBool m_time_stretch{INI_SECTION, "time_stretch", true};
+    option::OptionLong m_audio_latency{INI_SECTION, "audio_latency", EmuAudioLatencyType_100MS};
+    option::OptionBool m_audio_stats{INI_SECTION, "audio_stats", false};
+    option::OptionLong m_audio_backend{INI_SECTION, "audio_backend", EmuAudioBackendType_AUDOUT};
 
     option::OptionBool m_savestate_on_exit{INI_SECTION, "savestate_on_exit", false};
     option::OptionBool m_loadstate_on_start{INI_SECTION, "loadstate_on_start", false};
+    option::OptionLong m_autosave{INI_SECTION, "autosave", EmuAutoSaveType_OFF};
+
+    option::OptionLong m_rewind_codec{INI_SECTION, "rewind_codec", EmuRewindCodecType_AUTO};
+    option::OptionBool m_rewind_disk{INI_SECTION, "rewind_disk", false};
+    option::OptionBool m_rewind_disk_resume{INI_SECTION, "rewind_disk_resume", false};
+    option::OptionBool m_rewind_stats{INI_SECTION, "rewind_stats", false};
 
     int texture_current{};
     int texture_previous{};
@@ -157,6 +251,13 @@ public:
     uint32_t overscan_colour{};
 
     Rewind* rewind{};
+    RewindWorker rewind_worker{};
+    // older frames are moved here if enabled.
+    RewindDisk rewind_disk{};
+    // indexed by RewindCodecType, these must outlive the rewind.
+    RewindCodec rewind_codecs[RewindCodecType_MAX]{};
+    // loaded on rom load, used by RewindCodecType_LZ4_DICT.
+    std::vector<u8> rewind_dict{};
     void* rewind_buffer{};
     size_t rewind_buffer_size{};
 
@@ -165,6 +266,11 @@ public:
     // set to true when counter hits 0.
     bool rewind_should_push{};
 
+    // counts down every vblank, 0 if auto save is disabled.
+    size_t autosave_counter{};
+    // set to true when counter hits 0.
+    bool autosave_should_save{};
+
     // these point to the above buffer, do not free!
     void* rewind_pixel_buffer{};
     size_t rewind_pixel_buffer_size{};
@@ -172,8 +278,43 @@ public:
     size_t rewind_state_buffer_size{};
     struct SMS_StateConfig rewind_state_config{};
 
+    // rewind_pixel_buffer decoded to rgba, same size as the pixel buffer.
+    void* rewind_frame_buffer{};
+
+    // timestamps and thumbnails of the savestate slots for the loaded rom.
+    SaveStateIndex savestate_index{};
+    SaveStateWriter savestate_writer{};
+
+    // path of the battery save, reported by mgb when the save is loaded.
+    fs::FsPath sram_path{};
+    // size of the save that mgb writes, 0 until a save file has been seen.
+    size_t sram_size{};
+    // hash of the sram when it was last flushed, used to skip unchanged saves.
+    u64 sram_flushed_hash{};
+    TimeStamp sram_flush_ts{};
+
+    std::unique_ptr<AudioSink> audio_out{};
+    // time between updates, shown with the audio stats to match glitches to slow frames.
+    double frame_time_ms{};
+    double frame_time_max_ms{};
+    TimeStamp frame_time_ts{};
+
     // allocated sample buffer for audio callbacks.
     int16_t* sample_data{};
+    // buffer the core writes samples into. this is an audout buffer so that
+    // samples are written where they are played, unless they are stretched
+    // or captured first, then it is sample_data.
+    int16_t* core_audio_buffer{};
+    // number of samples the core writes before calling the audio callback.
+    size_t sample_block_size{};
+
+    // keeps the pitch of the audio when not running at 1x speed.
+    TimeStretch* time_stretch{};
+    // stretched samples waiting for a full block before being queued.
+    int16_t* time_stretch_buffer{};
+    size_t time_stretch_count{};
+    // set by the time stretch benchmark to capture audio instead of playing it.
+    std::vector<int16_t>* audio_capture{};
 
     // config
     // size of the emulator.
@@ -4,9 +4,15 @@
 #include "ui/scrolling_text.hpp"
 #include "ui/progress_box.hpp"
 #include "ui/list.hpp"
+#include "emu_helpers/savestate_preview.hpp"
+#include "dir_scanner.hpp"
+#include "dir_meta_loader.hpp"
+#include "rom_library.hpp"
+#include "trigram_index.hpp"
 #include "fs.hpp"
 #include "option.hpp"
 #include <span>
+#include <optional>
 
 namespace sphaira::ui::menu::filebrowser {
 
@@ -57,55 +63,144 @@ struct FsEntry {
     }
 };
 
-// roughly 1kib in size per entry
-struct FileEntry : FsDirectoryEntry {
-    std::string extension{}; // if any
-    std::string internal_name{}; // if any
-    std::string internal_extension{}; // if any
-    s64 file_count{-1}; // number of files in a folder, non-recursive
-    s64 dir_count{-1}; // number folders in a folder, non-recursive
-    FsTimeStampRaw time_stamp{};
-    bool checked_extension{}; // did we already search for an ext?
-    bool checked_internal_extension{}; // did we already search for an ext?
+enum FileEntryFlag : u8 {
+    FileEntryFlag_Dir = 1 << 0,
+    FileEntryFlag_Hidden = 1 << 1,
+    // modified is valid.
+    FileEntryFlag_TimeStamp = 1 << 2,
+    // the zip was opened to find the name of the file inside.
+    FileEntryFlag_CheckedInternal = 1 << 3,
+    // the size and modified were read from the file rather than the dir cache.
+    FileEntryFlag_Verified = 1 << 4,
+};
+
+// entries of a directory, stored as an array per field rather than an array of
+// structs and with the names packed into one buffer. an entry is around 40 bytes
+// plus its name, rather than the 1kib of a FsDirectoryEntry and a few strings,
+// and sorting or filtering only touches the fields it reads.
+struct FileEntries {
+    static constexpr u32 NO_NAME = UINT32_MAX;
+
+    void Clear();
+    // count is the total, names_size is the size of the names being added.
+    // grows geometrically, so this can be called for every chunk of a scan.
+    void Reserve(size_t count, size_t names_size);
+
+    // returns the index of the entry.
+    auto Add(std::string_view name, bool is_dir, s64 file_size) -> u32;
+
+    auto size() const -> size_t {
+        return m_flags.size();
+    }
+
+    auto empty() const -> bool {
+        return m_flags.empty();
+    }
+
+    auto GetName(u32 i) const -> const char* {
+        return m_names.data() + m_name_offset[i];
+    }
+
+    // the first 8 characters of the name in lower case, comparing keys orders
+    // names the same as strcasecmp() unless the keys are equal.
+    auto GetNameKey(u32 i) const -> u64 {
+        return m_name_key[i];
+    }
+
+    // empty if there is none.
+    auto GetExtension(u32 i) const -> std::string_view;
+
+    // name of the file in the zip, or the name if it is not a zip or was not checked.
+    auto GetInternalName(u32 i) const -> const char*;
+    auto GetInternalExtension(u32 i) const -> std::string_view;
+    auto HasInternalName(u32 i) const -> bool {
+        return m_internal_offset[i] != NO_NAME;
+    }
+    void SetInternalName(u32 i, std::string_view name);
+
+    auto IsDir(u32 i) const -> bool {
+        return m_flags[i] & FileEntryFlag_Dir;
+    }
+
+    auto IsFile(u32 i) const -> bool {
+        return !IsDir(i);
+    }
+
+    auto IsHidden(u32 i) const -> bool {
+        return m_flags[i] & FileEntryFlag_Hidden;
+    }
+
+    auto IsCheckedInternal(u32 i) const -> bool {
+        return m_flags[i] & FileEntryFlag_CheckedInternal;
+    }
 
-    auto IsFile() const -> bool {
-        return type == FsDirEntryType_File;
+    void SetCheckedInternal(u32 i) {
+        m_flags[i] |= FileEntryFlag_CheckedInternal;
     }
 
-    auto IsDir() const -> bool {
-        return !IsFile();
+    // the zip will be opened again.
+    void ClearInternalName(u32 i) {
+        m_internal_offset[i] = NO_NAME;
+        m_flags[i] &= ~FileEntryFlag_CheckedInternal;
     }
 
-    auto IsHidden() const -> bool {
-        return name[0] == '.';
+    auto IsVerified(u32 i) const -> bool {
+        return m_flags[i] & FileEntryFlag_Verified;
     }
 
-    auto GetName() const -> std::string {
-        return name;
+    void SetVerified(u32 i) {
+        m_flags[i] |= FileEntryFlag_Verified;
     }
 
-    auto GetExtension() const -> std::string {
-        if (!checked_extension) {
-            if (auto ext = std::strrchr(name, '.')) {
-                return ext+1;
-            }
-        }
-        return extension;
+    auto HasTimeStamp(u32 i) const -> bool {
+        return m_flags[i] & FileEntryFlag_TimeStamp;
     }
 
-    auto GetInternalName() const -> std::string {
-        if (!internal_name.empty()) {
-            return internal_name;
-        }
-        return GetName();
+    auto GetModified(u32 i) const -> u64 {
+        return m_modified[i];
     }
 
-    auto GetInternalExtension() const -> std::string {
-        if (!internal_extension.empty()) {
-            return internal_extension;
-        }
-        return GetExtension();
+    void SetModified(u32 i, u64 modified) {
+        m_modified[i] = modified;
+        m_flags[i] |= FileEntryFlag_TimeStamp;
     }
+
+    auto GetFileSize(u32 i) const -> s64 {
+        return m_file_size[i];
+    }
+
+    void SetFileSize(u32 i, s64 size) {
+        m_file_size[i] = size;
+    }
+
+    // number of files and folders in a folder, non-recursive. -1 if not loaded.
+    auto GetFileCount(u32 i) const -> s32 {
+        return m_file_count[i];
+    }
+
+    auto GetDirCount(u32 i) const -> s32 {
+        return m_dir_count[i];
+    }
+
+    void SetCounts(u32 i, s64 file_count, s64 dir_count) {
+        m_file_count[i] = file_count;
+        m_dir_count[i] = dir_count;
+    }
+
+private:
+    auto AddName(std::string_view name) -> u32;
+
+private:
+    // names, each followed by a null.
+    std::vector<char> m_names{};
+    std::vector<u32> m_name_offset{};
+    std::vector<u64> m_name_key{};
+    std::vector<u32> m_internal_offset{};
+    std::vector<s64> m_file_size{};
+    std::vector<u64> m_modified{};
+    std::vector<s32> m_file_count{};
+    std::vector<s32> m_dir_count{};
+    std::vector<u8> m_flags{};
 };
 
 struct LastFile {
@@ -160,43 +255,61 @@ struct FsView final : Widget {
 private:
     void SetIndex(s64 index);
 
-    auto Scan(const fs::FsPath& new_path, bool is_walk_up = false) -> Result;
-
-    auto GetNewPath(const FileEntry& entry) const -> fs::FsPath {
-        return GetNewPath(m_path, entry.name);
+    // entries are added as they are read, see UpdateScan().
+    // use_cache is cleared when the directory is known to have changed.
+    auto Scan(const fs::FsPath& new_path, bool is_walk_up = false, bool use_cache = true) -> Result;
+    void UpdateScan();
+    void AddEntries(std::span<const DirCacheEntry> entries, bool done);
+    // writes the listing of the current directory if it changed since it was loaded.
+    void SaveDirCache();
+    // applies loaded metadata and requests it for the rows around the visible ones.
+    void UpdateMeta();
+    void ApplyMeta(const DirMetaResult& result);
+
+    // takes an index in m_entries.
+    auto GetEntryPath(u32 entry) const -> fs::FsPath {
+        return GetNewPath(m_path, m_entries.GetName(entry));
     }
 
+    // takes an index in the list.
     auto GetNewPath(s64 index) const -> fs::FsPath {
-        return GetNewPath(m_path, GetEntry(index).name);
+        return GetEntryPath(GetEntry(index));
     }
 
     auto GetNewPathCurrent() const -> fs::FsPath {
         return GetNewPath(m_index);
     }
 
-    auto GetEntry(u32 index) -> FileEntry& {
-        return m_entries[m_entries_current[index]];
+    // returns the index in m_entries of the row in the list.
+    auto GetEntry(u32 index) const -> u32 {
+        return m_entries_current[index];
     }
 
-    auto GetEntry(u32 index) const -> const FileEntry& {
-        return m_entries[m_entries_current[index]];
-    }
-
-    auto GetEntry() -> FileEntry& {
+    auto GetEntry() const -> u32 {
         return GetEntry(m_index);
     }
 
-    auto GetEntry() const -> const FileEntry& {
-        return GetEntry(m_index);
+    auto GetEntryName() const -> const char* {
+        return m_entries.GetName(GetEntry());
     }
 
+    // true if the entry is a zip that has not been opened yet.
+    auto NeedsInternalName(u32 entry) const -> bool;
+
     auto IsSd() const -> bool {
         return m_fs_entry.type == FsType::Sd;
     }
 
     void Sort();
+    // returns the index list that is shown, based on the search and hidden options.
+    auto GetEntriesSource() -> std::vector<u32>&;
+    // flips the sorted list to the new order without sorting it again.
+    void ReverseOrder();
     void SortAndFindLastFile(bool scan = false);
     void SetIndexFromLastFile(const LastFile& last_file);
+    // waits for the entry to be scanned if a scan is in progress.
+    void RestoreLastFile(const LastFile& last_file);
+    auto FindEntry(const char* name) const -> s64;
 
     auto get_collection(const fs::FsPath& path, const fs::FsPath& parent_name, FsDirCollection& out, bool inc_file, bool inc_dir, bool inc_size) -> Result;
     auto get_collections(const fs::FsPath& path, const fs::FsPath& parent_name, FsDirCollections& out, bool inc_size = false) -> Result;
@@ -208,6 +321,14 @@ private:
     }
 
     void DisplayOptions();
+    // shows the entries of the current folder that contain query.
+    void Search(const std::string& query);
+    void ClearSearch();
+    auto IsSearching() const -> bool {
+        return !m_search_query.empty();
+    }
+    void UpdateSearch();
+    void DrawSaveStatePreview(NVGcontext* vg, Theme* theme, const Vec4& v, ThemeEntryID text_id);
 
 private:
     Menu* m_menu{};
@@ -216,11 +337,16 @@ private:
     std::unique_ptr<fs::Fs> m_fs{};
     FsEntry m_fs_entry{};
     fs::FsPath m_path{};
-    std::vector<FileEntry> m_entries{};
+    FileEntries m_entries{};
     std::vector<u32> m_entries_index{}; // files not including hidden
     std::vector<u32> m_entries_index_hidden{}; // includes hidden files
     std::vector<u32> m_entries_index_search{}; // files found via search
+    // names of m_entries, added as they are scanned.
+    TrigramIndex m_search_index{};
+    std::string m_search_query{};
     std::span<u32> m_entries_current{};
+    // order that m_entries_current was last sorted with.
+    s64 m_sorted_order{-1};
 
     std::unique_ptr<List> m_list{};
 
@@ -231,6 +357,27 @@ private:
     std::vector<LastFile> m_previous_highlighted_file{};
     s64 m_index{};
     ScrollingText m_scroll_name{};
+
+    DirScanner m_scanner{};
+    // highlighted once it is scanned, unless the user moves first.
+    std::optional<LastFile> m_scan_last_file{};
+    // time since the list was last sorted whilst scanning.
+    TimeStamp m_scan_sort_ts{};
+    // mtime of the current directory when it was scanned, 0 if it is not cached.
+    u64 m_dir_mtime{};
+    // entries in the current directory when it was scanned.
+    s64 m_dir_count{};
+    // set when the listing or its metadata differs from the cache.
+    bool m_dir_cache_dirty{};
+
+    DirMetaLoader m_meta_loader{};
+    // entries that metadata was last requested for, in m_entries.
+    std::vector<u32> m_meta_window{};
+
+    SaveStatePreviewCache m_preview_cache{};
+    // texture of the preview shown on the highlighted row.
+    std::shared_ptr<const SaveStatePreview> m_preview{};
+    int m_preview_image{};
 };
 
 struct Menu final : MenuBase {
@@ -255,11 +402,26 @@ private:
 
     void PromptIfShouldExit();
 
+    // folders in library_roots, separated by ';'.
+    auto GetLibraryRoots() -> std::vector<fs::FsPath>;
+    void RescanLibrary(bool notify);
+    // adds the names of the library entries to the search index, a chunk per frame.
+    void UpdateLibraryIndex(size_t max_count);
+    void SearchLibrary();
+
 private:
     static constexpr inline const char* INI_SECTION = "filebrowser";
 
     std::unique_ptr<FsView> view{};
 
+    RomLibrary m_library{};
+    // set if the user asked for the rescan, the result is then shown.
+    bool m_library_notify{};
+    // entries the search index was built from.
+    std::shared_ptr<const RomLibraryEntries> m_library_entries{};
+    u64 m_library_generation{};
+    TrigramIndex m_library_index{};
+
     // this keeps track of the highlighted file before opening a folder
     // if the user presses B to go back to the previous dir
     // this vector is popped, then, that entry is checked if it still exists
@@ -273,6 +435,8 @@ private:
     option::OptionBool m_folders_first{INI_SECTION, "folders_first", true, false};
     option::OptionBool m_hidden_last{INI_SECTION, "hidden_last", false, false};
     option::OptionBool m_ignore_read_only{INI_SECTION, "ignore_read_only", false, false};
+    option::OptionBool m_savestate_preview{INI_SECTION, "savestate_preview", true, false};
+    option::OptionString m_library_roots{INI_SECTION, "library_roots", "/roms"};
 };
 
 } // namespace sphaira::ui::menu::filebrowser
@@ -0,0 +1,151 @@
+#include "dir_cache.hpp"
+#include "emu_helpers/savestate_writer.hpp"
+#include "defines.hpp"
+#include <cstring>
+#include <cstdio>
+
+namespace sphaira {
+namespace {
+
+constexpr u32 CACHE_MAGIC = 0x52494454; // TDIR
+constexpr u32 CACHE_VERSION = 1;
+
+enum CacheEntryFlag : u8 {
+    CacheEntryFlag_TimeStamp = 1 << 0,
+    CacheEntryFlag_CheckedInternal = 1 << 1,
+};
+
+struct CacheHeader {
+    u32 magic;
+    u32 version;
+    u64 mtime;
+    s64 dir_count;
+    u32 count;
+    u16 path_len;
+    u16 reserved;
+    // followed by the path of the directory.
+};
+
+struct CacheEntry {
+    s64 file_size;
+    u64 modified;
+    u16 name_len;
+    u16 internal_len;
+    s8 type;
+    u8 flags;
+    u8 reserved[2];
+    // followed by the name and the internal name.
+};
+
+template <typename T>
+void Append(std::vector<u8>& data, const T* ptr, size_t size) {
+    const auto p = (const u8*)ptr;
+    data.insert(data.end(), p, p + size);
+}
+
+} // namespace
+
+auto DirCache::GetCachePath(const fs::FsPath& dir_path) -> fs::FsPath {
+    char name[32];
+    // the path is also stored in the file in case of a collision.
+    std::snprintf(name, sizeof(name), "%016lX.bin", fs::HashPath(dir_path));
+    return fs::FsPath{PATH} + name;
+}
+
+auto DirCache::GetDirMtime(fs::Fs* fs, const fs::FsPath& dir_path) -> u64 {
+    FsTimeStampRaw ts{};
+    if (R_FAILED(fs->GetFileTimeStampRaw(dir_path, &ts)) || !ts.is_valid) {
+        return 0;
+    }
+    return ts.modified;
+}
+
+auto DirCache::GetDirCount(fs::Fs* fs, const fs::FsPath& dir_path) -> s64 {
+    s64 count{};
+    if (R_FAILED(fs->DirGetEntryCount(dir_path, &count, FsDirOpenMode_ReadDirs | FsDirOpenMode_ReadFiles))) {
+        return -1;
+    }
+    return count;
+}
+
+Result DirCache::Load(const fs::FsPath& dir_path) {
+    path = dir_path;
+    mtime = 0;
+    count = 0;
+    entries.clear();
+
+    std::vector<u8> data;
+    R_TRY(SaveStateWriter::ReadFile(GetCachePath(dir_path), data));
+
+    CacheHeader header;
+    R_UNLESS(data.size() >= sizeof(header), 0x1);
+    std::memcpy(&header, data.data(), sizeof(header));
+    R_UNLESS(header.magic == CACHE_MAGIC && header.version == CACHE_VERSION, 0x1);
+
+    size_t off = sizeof(header);
+    R_UNLESS(off + header.path_len <= data.size(), 0x1);
+    R_UNLESS(header.path_len == std::strlen(dir_path) && !std::memcmp(data.data() + off, dir_path.s, header.path_len), 0x1);
+    off += header.path_len;
+
+    // stops a corrupt count from allocating more entries than the file could hold.
+    R_UNLESS(header.count <= (data.size() - off) / sizeof(CacheEntry), 0x1);
+    entries.resize(header.count);
+    for (auto& e : entries) {
+        CacheEntry entry;
+        R_UNLESS(off + sizeof(entry) <= data.size(), 0x1);
+        std::memcpy(&entry, data.data() + off, sizeof(entry));
+        off += sizeof(entry);
+
+        R_UNLESS(off + entry.name_len + entry.internal_len <= data.size(), 0x1);
+
+        e.name.assign((const char*)data.data() + off, entry.name_len);
+        off += entry.name_len;
+        e.internal_name.assign((const char*)data.data() + off, entry.internal_len);
+        off += entry.internal_len;
+
+        e.type = entry.type;
+        e.file_size = entry.file_size;
+        e.time_stamp.modified = entry.modified;
+        e.time_stamp.is_valid = entry.flags & CacheEntryFlag_TimeStamp;
+        e.checked_internal = entry.flags & CacheEntryFlag_CheckedInternal;
+    }
+
+    mtime = header.mtime;
+    count = header.dir_count;
+    R_SUCCEED();
+}
+
+Result DirCache::Save() const {
+    fs::FsNativeSd fs;
+    const auto cache_path = GetCachePath(path);
+    fs.CreateDirectoryRecursivelyWithPath(cache_path);
+    // a power loss whilst saving keeps the previous cache instead of a truncated one.
+    return SaveStateWriter::WriteFile(cache_path, Serialize());
+}
+
+auto DirCache::Serialize() const -> std::vector<u8> {
+    std::vector<u8> data;
+
+    const CacheHeader header{CACHE_MAGIC, CACHE_VERSION, mtime, count, (u32)entries.size(), (u16)std::strlen(path), 0};
+    Append(data, &header, sizeof(header));
+    Append(data, path.s, header.path_len);
+
+    for (const auto& e : entries) {
+        u8 flags{};
+        if (e.time_stamp.is_valid) {
+            flags |= CacheEntryFlag_TimeStamp;
+        }
+        if (e.checked_internal) {
+            flags |= CacheEntryFlag_CheckedInternal;
+        }
+
+        const CacheEntry entry{e.file_size, e.time_stamp.modified, (u16)e.name.length(), (u16)e.internal_name.length(), e.type, flags, {}};
+        Append(data, &entry, sizeof(entry));
+        Append(data, e.name.data(), entry.name_len);
+        Append(data, e.internal_name.data(), entry.internal_len);
+    }
+
+    return data;
+}
+
+} // namespace sphaira
@@ -0,0 +1,150 @@
+#include "dir_meta_loader.hpp"
+#include "minizip_helper.hpp"
+#include "defines.hpp"
+
+namespace sphaira {
+
+DirMetaLoader::~DirMetaLoader() {
+    Exit();
+}
+
+Result DirMetaLoader::Init() {
+    Exit();
+
+    m_fs = nullptr;
+    m_requests.clear();
+    m_next = 0;
+    m_results.clear();
+    m_quit = false;
+
+    mutexInit(&m_mutex);
+    condvarInit(&m_can_work);
+
+    R_TRY(threadCreate(&m_thread, ThreadFunc, this, nullptr, 1024*64, 0x3F, 2));
+    if (R_FAILED(threadStart(&m_thread))) {
+        threadClose(&m_thread);
+        R_THROW(0x1);
+    }
+
+    m_running = true;
+    R_SUCCEED();
+}
+
+void DirMetaLoader::Exit() {
+    if (!m_running) {
+        return;
+    }
+
+    mutexLock(&m_mutex);
+    m_quit = true;
+    condvarWakeAll(&m_can_work);
+    mutexUnlock(&m_mutex);
+
+    threadWaitForExit(&m_thread);
+    threadClose(&m_thread);
+
+    m_requests.clear();
+    m_results.clear();
+    m_running = false;
+}
+
+void DirMetaLoader::Reset(fs::Fs* fs) {
+    if (!m_running) {
+        return;
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    m_fs = fs;
+    m_generation++;
+    m_requests.clear();
+    m_next = 0;
+    m_results.clear();
+}
+
+void DirMetaLoader::Request(std::vector<DirMetaRequest>&& requests) {
+    if (!m_running) {
+        return;
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    m_requests = std::move(requests);
+    m_next = 0;
+    condvarWakeOne(&m_can_work);
+}
+
+void DirMetaLoader::Poll(std::vector<DirMetaResult>& out) {
+    if (!m_running) {
+        return;
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    std::swap(out, m_results);
+    m_results.clear();
+}
+
+auto DirMetaLoader::Load(fs::Fs* fs, const DirMetaRequest& request) -> DirMetaResult {
+    DirMetaResult result{};
+    result.index = request.index;
+    result.is_dir = request.is_dir;
+
+    if (request.is_dir) {
+        if (R_FAILED(fs->DirGetEntryCount(request.path, &result.file_count, &result.dir_count))) {
+            result.file_count = -1;
+            result.dir_count = -1;
+        }
+    } else {
+        if (!request.load_time_stamp) {
+            // already loaded.
+        } else if (fs->IsNative() && !request.load_size) {
+            // the size is already known from reading the directory.
+            fs->GetFileTimeStampRaw(request.path, &result.time_stamp);
+        } else {
+            fs->FileGetSizeAndTimestamp(request.path, &result.time_stamp, &result.file_size);
+        }
+
+        if (request.load_internal) {
+            fs::FsPath name{};
+            if (R_SUCCEEDED(mz::PeekFirstFileName(fs, request.path, name))) {
+                result.internal_name = name.s;
+            }
+            result.checked_internal = true;
+        }
+    }
+
+    return result;
+}
+
+void DirMetaLoader::ThreadFunc(void* arg) {
+    static_cast<DirMetaLoader*>(arg)->ThreadLoop();
+}
+
+void DirMetaLoader::ThreadLoop() {
+    for (;;) {
+        fs::Fs* fs;
+        DirMetaRequest request;
+        u64 generation;
+        {
+            SCOPED_MUTEX(&m_mutex);
+            while ((m_next >= m_requests.size() || !m_fs) && !m_quit) {
+                condvarWait(&m_can_work, &m_mutex);
+            }
+
+            if (m_quit) {
+                break;
+            }
+
+            fs = m_fs;
+            request = m_requests[m_next++];
+            generation = m_generation;
+        }
+
+        const auto result = Load(fs, request);
+
+        SCOPED_MUTEX(&m_mutex);
+        if (generation == m_generation) {
+            m_results.emplace_back(result);
+        }
+    }
+}
+
+} // namespace sphaira
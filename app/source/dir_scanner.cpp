@@ -0,0 +1,235 @@
+#include "dir_scanner.hpp"
+#include "defines.hpp"
+#include "log.hpp"
+#include "ui/types.hpp"
+#include <iterator>
+
+namespace sphaira {
+namespace {
+
+// large enough that a read is mostly spent in fs, small enough that the
+// first rows show up straight away.
+constexpr s64 CHUNK_SIZE = 256;
+
+} // namespace
+
+DirScanner::~DirScanner() {
+    Exit();
+}
+
+Result DirScanner::Init() {
+    Exit();
+
+    m_fs = nullptr;
+    m_pending = false;
+    m_done = false;
+    m_entries.clear();
+    m_saves.clear();
+    m_quit = false;
+
+    mutexInit(&m_mutex);
+    condvarInit(&m_can_work);
+
+    R_TRY(threadCreate(&m_thread, ThreadFunc, this, nullptr, 1024*64, 0x3F, 2));
+    if (R_FAILED(threadStart(&m_thread))) {
+        threadClose(&m_thread);
+        R_THROW(0x1);
+    }
+
+    m_running = true;
+    R_SUCCEED();
+}
+
+void DirScanner::Exit() {
+    if (!m_running) {
+        return;
+    }
+
+    mutexLock(&m_mutex);
+    m_quit = true;
+    m_generation++;
+    condvarWakeAll(&m_can_work);
+    mutexUnlock(&m_mutex);
+
+    threadWaitForExit(&m_thread);
+    threadClose(&m_thread);
+
+    m_entries.clear();
+    m_saves.clear();
+    m_scanning = false;
+    m_running = false;
+}
+
+void DirScanner::Start(fs::Fs* fs, const fs::FsPath& path, bool use_cache) {
+    if (!m_running) {
+        return;
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    m_fs = fs;
+    m_path = path;
+    m_use_cache = use_cache;
+    m_generation++;
+    m_pending = true;
+    m_done = false;
+    m_result = {};
+    m_entries.clear();
+    m_scanning = true;
+    condvarWakeOne(&m_can_work);
+}
+
+void DirScanner::Cancel() {
+    if (!m_running) {
+        return;
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    m_generation++;
+    m_pending = false;
+    m_done = false;
+    m_entries.clear();
+    m_scanning = false;
+}
+
+void DirScanner::Save(DirCache&& cache) {
+    if (!m_running) {
+        return;
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    m_saves.emplace_back(std::move(cache));
+    condvarWakeOne(&m_can_work);
+}
+
+auto DirScanner::Poll(std::vector<DirCacheEntry>& out, DirScanResult& result) -> bool {
+    if (!m_scanning) {
+        return false;
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    if (out.empty()) {
+        std::swap(out, m_entries);
+    } else {
+        out.insert(out.end(), std::make_move_iterator(m_entries.begin()), std::make_move_iterator(m_entries.end()));
+        m_entries.clear();
+    }
+
+    if (!m_done) {
+        return false;
+    }
+
+    result = m_result;
+    m_done = false;
+    m_scanning = false;
+    return true;
+}
+
+void DirScanner::ThreadFunc(void* arg) {
+    static_cast<DirScanner*>(arg)->ThreadLoop();
+}
+
+void DirScanner::ThreadLoop() {
+    for (;;) {
+        std::vector<DirCache> saves;
+        fs::Fs* fs{};
+        fs::FsPath path;
+        bool use_cache{};
+        u64 generation{};
+        {
+            SCOPED_MUTEX(&m_mutex);
+            while (!m_pending && m_saves.empty() && !m_quit) {
+                condvarWait(&m_can_work, &m_mutex);
+            }
+
+            std::swap(saves, m_saves);
+            if (m_pending && !m_quit) {
+                m_pending = false;
+                fs = m_fs;
+                path = m_path;
+                use_cache = m_use_cache;
+                generation = m_generation;
+            }
+        }
+
+        // saves are written even when quitting, so that they are not lost on exit.
+        for (const auto& cache : saves) {
+            if (R_FAILED(cache.Save())) {
+                log_write("[scan] failed to save cache: %s\n", cache.path.s);
+            }
+        }
+
+        if (!fs) {
+            SCOPED_MUTEX(&m_mutex);
+            if (m_quit && m_saves.empty()) {
+                break;
+            }
+            continue;
+        }
+
+        u64 mtime{};
+        s64 count{};
+        bool cached{};
+        const auto rc = ScanDir(fs, path, use_cache, generation, mtime, count, cached);
+
+        SCOPED_MUTEX(&m_mutex);
+        if (generation == m_generation) {
+            m_result = {rc, mtime, count, cached};
+            m_done = true;
+        }
+    }
+}
+
+Result DirScanner::ScanDir(fs::Fs* fs, const fs::FsPath& path, bool use_cache, u64 generation, u64& mtime, s64& count, bool& cached) {
+    TimeStamp ts;
+    ON_SCOPE_EXIT(log_write("[scan] %s cached: %u time taken: %.2fs %zums\n", path.s, cached, ts.GetSecondsD(), ts.GetMs()));
+
+    // read before the directory so that a change whilst reading invalidates the cache.
+    // the count is cheap to read and catches files added without the mtime changing.
+    mtime = DirCache::GetDirMtime(fs, path);
+    if (mtime) {
+        count = DirCache::GetDirCount(fs, path);
+        if (count < 0) {
+            mtime = 0;
+        }
+    }
+
+    if (use_cache && mtime) {
+        DirCache cache;
+        if (R_SUCCEEDED(cache.Load(path)) && cache.mtime == mtime && cache.count == count) {
+            SCOPED_MUTEX(&m_mutex);
+            if (generation == m_generation) {
+                m_entries = std::move(cache.entries);
+                cached = true;
+            }
+            R_SUCCEED();
+        }
+    }
+
+    fs::Dir d;
+    R_TRY(fs->OpenDirectory(path, FsDirOpenMode_ReadDirs | FsDirOpenMode_ReadFiles, &d));
+
+    std::vector<FsDirectoryEntry> chunk(CHUNK_SIZE);
+    for (;;) {
+        s64 count{};
+        R_TRY(d.Read(&count, chunk.size(), chunk.data()));
+
+        SCOPED_MUTEX(&m_mutex);
+        if (generation != m_generation) {
+            log_write("[scan] cancelled: %s\n", path.s);
+            R_SUCCEED();
+        }
+
+        if (count <= 0) {
+            R_SUCCEED();
+        }
+
+        for (s64 i = 0; i < count; i++) {
+            auto& e = m_entries.emplace_back();
+            e.name = chunk[i].name;
+            e.type = chunk[i].type;
+            e.file_size = chunk[i].file_size;
+        }
+    }
+}
+
+} // namespace sphaira
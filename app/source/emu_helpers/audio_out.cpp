@@ -0,0 +1,266 @@
+#include "emu_helpers/audio_out.hpp"
+#include "defines.hpp"
+#include "log.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+namespace sphaira {
+namespace {
+
+constexpr size_t BUFFER_ALIGN = 0x1000;
+// the queue shrinks by one block after this long without an underrun.
+constexpr u64 SHRINK_SECONDS = 10;
+// one block is always queued whilst the next one is being filled.
+constexpr u32 MIN_QUEUED = 2;
+// leaves a buffer for the core to write into whilst the queue is full.
+constexpr u32 MAX_QUEUED = AudioOut::MAX_BUFFERS - 1;
+
+} // namespace
+
+AudioOut::~AudioOut() {
+    Exit();
+}
+
+Result AudioOut::Init(u32 sample_rate, u32 max_block_size) {
+    Exit();
+
+    m_sample_rate = sample_rate;
+    m_max_block_size = max_block_size;
+    m_stride = (max_block_size * sizeof(s16) + BUFFER_ALIGN - 1) & ~(BUFFER_ALIGN - 1);
+    m_memory = aligned_alloc(BUFFER_ALIGN, m_stride * MAX_BUFFERS);
+    R_UNLESS(m_memory, 0x1);
+    std::memset(m_memory, 0, m_stride * MAX_BUFFERS);
+
+    for (u32 i = 0; i < MAX_BUFFERS; i++) {
+        m_buffers[i] = {};
+        m_buffers[i].buffer = (u8*)m_memory + m_stride * i;
+        m_buffers[i].buffer_size = m_stride;
+        m_state[i] = BufferState_Free;
+    }
+
+    if (R_FAILED(audoutInitialize())) {
+        std::free(m_memory);
+        m_memory = nullptr;
+        R_THROW(0x1);
+    }
+
+    audoutStartAudioOut();
+    m_running = true;
+    Configure(max_block_size, 0);
+    R_SUCCEED();
+}
+
+void AudioOut::Exit() {
+    if (!m_running) {
+        return;
+    }
+
+    audoutStopAudioOut();
+    audoutExit();
+    std::free(m_memory);
+    m_memory = nullptr;
+    m_running = false;
+}
+
+void AudioOut::Start() {
+    audoutStartAudioOut();
+}
+
+void AudioOut::Stop() {
+    audoutStopAudioOut();
+}
+
+void AudioOut::Flush() {
+    if (!m_running) {
+        return;
+    }
+
+    audoutFlushAudioOutBuffers(NULL);
+    m_playing = false;
+    m_resync = true;
+}
+
+void AudioOut::Configure(u32 block_size, u32 latency_ms) {
+    m_block_size = std::min(block_size, m_max_block_size);
+
+    const u64 latency_samples = (u64)m_sample_rate * 2 * latency_ms / 1000;
+    m_target_queued = std::clamp<u32>((latency_samples + m_block_size - 1) / m_block_size, MIN_QUEUED, MAX_QUEUED);
+    m_max_queued = m_target_queued;
+    m_stable_ts.Update();
+
+    log_write("[audio] block: %u samples queue: %u\n", m_block_size, m_max_queued);
+    Flush();
+}
+
+void AudioOut::PollReleased() {
+    if (m_resync) {
+        m_resync = false;
+        for (u32 i = 0; i < MAX_BUFFERS; i++) {
+            bool contains;
+            if (m_state[i] == BufferState_Queued && R_SUCCEEDED(audoutContainsAudioOutBuffer(&m_buffers[i], &contains)) && !contains) {
+                m_state[i] = BufferState_Free;
+            }
+        }
+    }
+
+    for (;;) {
+        AudioOutBuffer* released{};
+        u32 count{};
+        if (R_FAILED(audoutGetReleasedAudioOutBuffer(&released, &count)) || !count || !released) {
+            break;
+        }
+
+        const auto index = released - m_buffers;
+        if (index >= 0 && index < MAX_BUFFERS && m_state[index] == BufferState_Queued) {
+            m_state[index] = BufferState_Free;
+
+            // this is when the release was seen rather than when it happened,
+            // so it is late by up to the time between submits.
+            m_latency_ns = armTicksToNs(armGetSystemTick() - m_submit_tick[index]);
+            m_latency_max_ns = std::max(m_latency_max_ns, m_latency_ns);
+            m_latency_total_ns += m_latency_ns;
+            m_latency_count++;
+        }
+    }
+}
+
+auto AudioOut::GetQueuedCount() const -> u32 {
+    return std::count(std::begin(m_state), std::end(m_state), BufferState_Queued);
+}
+
+auto AudioOut::FindBuffer(const s16* samples) const -> s32 {
+    const auto off = (const u8*)samples - (const u8*)m_memory;
+    if (!m_memory || off < 0 || off >= (s64)(m_stride * MAX_BUFFERS) || off % m_stride) {
+        return -1;
+    }
+    return off / m_stride;
+}
+
+auto AudioOut::FindFree() const -> s32 {
+    const auto it = std::find(std::begin(m_state), std::end(m_state), BufferState_Free);
+    if (it == std::end(m_state)) {
+        return -1;
+    }
+    return it - std::begin(m_state);
+}
+
+void AudioOut::Adapt(u32 queued) {
+    if (!queued && m_playing) {
+        m_underruns++;
+        m_stable_ts.Update();
+        if (m_max_queued < MAX_QUEUED) {
+            m_max_queued++;
+            log_write("[audio] underrun, queue: %u\n", m_max_queued);
+        }
+    } else if (m_max_queued > m_target_queued && m_stable_ts.GetSeconds() >= SHRINK_SECONDS) {
+        m_stable_ts.Update();
+        m_max_queued--;
+        log_write("[audio] stable, queue: %u\n", m_max_queued);
+    }
+}
+
+auto AudioOut::Acquire() -> s16* {
+    if (!m_running) {
+        return nullptr;
+    }
+
+    PollReleased();
+    const auto index = FindFree();
+    if (index < 0) {
+        return nullptr;
+    }
+
+    m_state[index] = BufferState_Owned;
+    return (s16*)m_buffers[index].buffer;
+}
+
+bool AudioOut::Submit(const s16* samples, u32 size) {
+    if (!m_running) {
+        return false;
+    }
+
+    PollReleased();
+    const auto queued = GetQueuedCount();
+    Adapt(queued);
+
+    m_queue_depth = queued;
+    m_queue_depth_max = std::max(m_queue_depth_max, queued);
+    m_queue_depth_total += queued;
+    m_submitted++;
+
+    if (queued >= m_max_queued) {
+        m_overruns++;
+        return false;
+    }
+
+    auto index = FindBuffer(samples);
+    if (index < 0 || m_state[index] != BufferState_Owned) {
+        index = FindFree();
+        if (index < 0) {
+            m_overruns++;
+            return false;
+        }
+        std::memcpy(m_buffers[index].buffer, samples, std::min(size, m_max_block_size) * sizeof(*samples));
+    }
+
+    auto& buf_out = m_buffers[index];
+    buf_out.data_size = std::min(size, m_max_block_size) * sizeof(*samples);
+    armDCacheFlush(buf_out.buffer, buf_out.data_size);
+
+    if (R_FAILED(audoutAppendAudioOutBuffer(&buf_out))) {
+        return false;
+    }
+
+    m_state[index] = BufferState_Queued;
+    m_submit_tick[index] = armGetSystemTick();
+    m_playing = true;
+    return true;
+}
+
+void AudioOut::Release(const s16* buffer) {
+    const auto index = FindBuffer(buffer);
+    if (index >= 0 && m_state[index] == BufferState_Owned) {
+        m_state[index] = BufferState_Free;
+    }
+}
+
+auto AudioOut::GetStats() const -> AudioSinkStats {
+    AudioSinkStats stats{};
+    stats.underruns = m_underruns;
+    stats.dropped = m_overruns;
+    stats.submitted = m_submitted;
+    stats.queue_depth = m_queue_depth;
+    stats.queue_depth_max = m_queue_depth_max;
+    stats.queue_depth_avg = m_submitted ? (double)m_queue_depth_total / m_submitted : 0;
+    stats.max_queued = m_max_queued;
+    stats.latency_ms = m_latency_ns / 1e+6;
+    stats.latency_avg_ms = m_latency_count ? m_latency_total_ns / 1e+6 / m_latency_count : 0;
+    stats.latency_max_ms = m_latency_max_ns / 1e+6;
+    return stats;
+}
+
+void AudioOut::ResetStats() {
+    m_underruns = 0;
+    m_overruns = 0;
+    m_submitted = 0;
+    m_queue_depth = 0;
+    m_queue_depth_max = 0;
+    m_queue_depth_total = 0;
+    m_latency_ns = 0;
+    m_latency_max_ns = 0;
+    m_latency_total_ns = 0;
+    m_latency_count = 0;
+}
+
+auto AudioOut::GetFreeCount() -> u32 {
+    if (!m_running) {
+        return 0;
+    }
+
+    PollReleased();
+    const auto queued = GetQueuedCount();
+    return queued < m_max_queued ? m_max_queued - queued : 0;
+}
+
+} // namespace sphaira
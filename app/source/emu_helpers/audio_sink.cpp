@@ -0,0 +1,141 @@
+#include "emu_helpers/audio_sink.hpp"
+#include "log.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace sphaira {
+namespace {
+
+// one block is always queued whilst the next one is being filled.
+constexpr uint32_t MIN_QUEUED = 2;
+
+struct WavHeader {
+    char riff[4];
+    uint32_t riff_size;
+    char wave[4];
+    char fmt[4];
+    uint32_t fmt_size;
+    uint16_t format;
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint32_t byte_rate;
+    uint16_t block_align;
+    uint16_t bits_per_sample;
+    char data[4];
+    uint32_t data_size;
+};
+static_assert(sizeof(WavHeader) == 44);
+
+// riff_size is 32 bits and includes the rest of the header, this is about
+// 6 hours at 48kHz. the limit is a whole number of stereo s16 frames.
+constexpr uint32_t WAV_MAX_DATA_SIZE = (UINT32_MAX - (sizeof(WavHeader) - 8)) & ~3u;
+
+} // namespace
+
+AudioSinkNull::AudioSinkNull(uint32_t sample_rate, uint32_t max_block_size) : m_buffer(max_block_size), m_sample_rate{sample_rate} {
+    Configure(max_block_size, 0);
+}
+
+void AudioSinkNull::Configure(uint32_t block_size, uint32_t latency_ms) {
+    // nothing is queued, this is only the number of blocks the core runs for at once with audio sync.
+    m_max_queued = MIN_QUEUED;
+    if (block_size) {
+        const uint64_t latency_samples = (uint64_t)m_sample_rate * 2 * latency_ms / 1000;
+        m_max_queued = std::max<uint32_t>((latency_samples + block_size - 1) / block_size, MIN_QUEUED);
+    }
+}
+
+auto AudioSinkNull::Acquire() -> int16_t* {
+    return m_buffer.data();
+}
+
+bool AudioSinkNull::Submit(const int16_t*, uint32_t) {
+    m_submitted++;
+    return true;
+}
+
+auto AudioSinkNull::GetFreeCount() -> uint32_t {
+    return m_max_queued;
+}
+
+auto AudioSinkNull::GetStats() const -> AudioSinkStats {
+    AudioSinkStats stats{};
+    stats.submitted = m_submitted;
+    stats.max_queued = m_max_queued;
+    return stats;
+}
+
+void AudioSinkNull::ResetStats() {
+    m_submitted = 0;
+}
+
+AudioSinkWav::AudioSinkWav(uint32_t sample_rate, uint32_t max_block_size) : AudioSinkNull{sample_rate, max_block_size} {
+
+}
+
+AudioSinkWav::~AudioSinkWav() {
+    Close();
+}
+
+bool AudioSinkWav::Open(const char* path) {
+    Close();
+
+    m_file = std::fopen(path, "wb");
+    if (!m_file) {
+        return false;
+    }
+
+    m_data_size = 0;
+    WriteHeader();
+    return true;
+}
+
+void AudioSinkWav::Close() {
+    if (!m_file) {
+        return;
+    }
+
+    std::fseek(m_file, 0, SEEK_SET);
+    WriteHeader();
+    std::fclose(m_file);
+    m_file = nullptr;
+}
+
+bool AudioSinkWav::Submit(const int16_t* samples, uint32_t size) {
+    AudioSinkNull::Submit(samples, size);
+
+    if (m_file) {
+        const auto max_size = (WAV_MAX_DATA_SIZE - m_data_size) / sizeof(*samples);
+        const auto count = std::min<uint32_t>(size, max_size);
+
+        // wav is little endian, as is every platform this runs on.
+        m_data_size += std::fwrite(samples, sizeof(*samples), count, m_file) * sizeof(*samples);
+
+        if (count < size) {
+            log_write("[audio] wav reached the 4GiB limit, recording stopped\n");
+            Close();
+        }
+    }
+
+    return true;
+}
+
+void AudioSinkWav::WriteHeader() {
+    WavHeader header{};
+    std::memcpy(header.riff, "RIFF", 4);
+    header.riff_size = sizeof(header) - 8 + m_data_size;
+    std::memcpy(header.wave, "WAVE", 4);
+    std::memcpy(header.fmt, "fmt ", 4);
+    header.fmt_size = 16;
+    header.format = 1; // pcm
+    header.channels = 2;
+    header.sample_rate = m_sample_rate;
+    header.bits_per_sample = 16;
+    header.block_align = header.channels * header.bits_per_sample / 8;
+    header.byte_rate = header.sample_rate * header.block_align;
+    std::memcpy(header.data, "data", 4);
+    header.data_size = m_data_size;
+    std::fwrite(&header, sizeof(header), 1, m_file);
+}
+
+} // namespace sphaira
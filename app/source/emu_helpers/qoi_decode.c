@@ -0,0 +1,136 @@
+#include "emu_helpers/qoi_decode.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* see https://qoiformat.org/qoi-specification.pdf */
+enum
+{
+    QOI_OP_INDEX = 0x00,
+    QOI_OP_DIFF = 0x40,
+    QOI_OP_LUMA = 0x80,
+    QOI_OP_RUN = 0xC0,
+    QOI_OP_RGB = 0xFE,
+    QOI_OP_RGBA = 0xFF,
+    QOI_MASK_2 = 0xC0,
+};
+
+enum { QOI_HEADER_SIZE = 14, QOI_PADDING_SIZE = 8 };
+
+/* thumbnails are small, this only stops a corrupt header from asking for gigabytes. */
+enum { QOI_MAX_SIZE = 4096 };
+
+static uint32_t qoi_read_32(const uint8_t* src)
+{
+    return (uint32_t)src[0] << 24 | (uint32_t)src[1] << 16 | (uint32_t)src[2] << 8 | src[3];
+}
+
+static uint32_t qoi_pack(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    return (uint32_t)r | (uint32_t)g << 8 | (uint32_t)b << 16 | (uint32_t)a << 24;
+}
+
+uint32_t* qoi_decode_rgba(const void* data, size_t size, uint32_t* w, uint32_t* h)
+{
+    const uint8_t* src = data;
+    if (!src || !w || !h || size < QOI_HEADER_SIZE + QOI_PADDING_SIZE || memcmp(src, "qoif", 4))
+    {
+        return NULL;
+    }
+
+    const uint32_t width = qoi_read_32(src + 4);
+    const uint32_t height = qoi_read_32(src + 8);
+    const uint8_t channels = src[12];
+    if (!width || !height || width > QOI_MAX_SIZE || height > QOI_MAX_SIZE || (channels != 3 && channels != 4))
+    {
+        return NULL;
+    }
+
+    const size_t count = (size_t)width * height;
+    uint32_t* dst = malloc(count * sizeof(uint32_t));
+    if (!dst)
+    {
+        return NULL;
+    }
+
+    uint32_t index[64] = {0};
+    uint8_t r = 0, g = 0, b = 0, a = 255;
+    unsigned run = 0;
+    size_t off = QOI_HEADER_SIZE;
+    const size_t end = size - QOI_PADDING_SIZE;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (run)
+        {
+            run--;
+        }
+        else
+        {
+            if (off >= end)
+            {
+                free(dst);
+                return NULL;
+            }
+
+            const uint8_t b1 = src[off++];
+
+            if (b1 == QOI_OP_RGB || b1 == QOI_OP_RGBA)
+            {
+                const size_t len = b1 == QOI_OP_RGB ? 3 : 4;
+                if (end - off < len)
+                {
+                    free(dst);
+                    return NULL;
+                }
+
+                r = src[off++];
+                g = src[off++];
+                b = src[off++];
+                if (b1 == QOI_OP_RGBA)
+                {
+                    a = src[off++];
+                }
+            }
+            else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX)
+            {
+                const uint32_t px = index[b1];
+                r = px;
+                g = px >> 8;
+                b = px >> 16;
+                a = px >> 24;
+            }
+            else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF)
+            {
+                r += ((b1 >> 4) & 0x03) - 2;
+                g += ((b1 >> 2) & 0x03) - 2;
+                b += (b1 & 0x03) - 2;
+            }
+            else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA)
+            {
+                if (off >= end)
+                {
+                    free(dst);
+                    return NULL;
+                }
+
+                const uint8_t b2 = src[off++];
+                const int vg = (b1 & 0x3F) - 32;
+                r += vg - 8 + ((b2 >> 4) & 0x0F);
+                g += vg;
+                b += vg - 8 + (b2 & 0x0F);
+            }
+            else
+            {
+                run = b1 & 0x3F;
+            }
+
+            index[(r * 3 + g * 5 + b * 7 + a * 11) % 64] = qoi_pack(r, g, b, a);
+        }
+
+        dst[i] = qoi_pack(r, g, b, a);
+    }
+
+    *w = width;
+    *h = height;
+    return dst;
+}
@@ -0,0 +1,134 @@
+#include "emu_helpers/qoi_encode.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* see https://qoiformat.org/qoi-specification.pdf */
+enum
+{
+    QOI_OP_INDEX = 0x00,
+    QOI_OP_DIFF = 0x40,
+    QOI_OP_LUMA = 0x80,
+    QOI_OP_RUN = 0xC0,
+    QOI_OP_RGB = 0xFE,
+};
+
+enum { QOI_HEADER_SIZE = 14 };
+static const uint8_t QOI_PADDING[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+static void qoi_write_32(uint8_t* dst, size_t* off, uint32_t v)
+{
+    dst[(*off)++] = v >> 24;
+    dst[(*off)++] = v >> 16;
+    dst[(*off)++] = v >> 8;
+    dst[(*off)++] = v;
+}
+
+static unsigned qoi_hash(uint8_t r, uint8_t g, uint8_t b)
+{
+    return (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+}
+
+void* qoi_encode_rgbx(const uint32_t* pixels, uint32_t w, uint32_t h, uint32_t stride, size_t* out_size)
+{
+    if (!pixels || !w || !h || !out_size)
+    {
+        return NULL;
+    }
+
+    /* worst case is every pixel being QOI_OP_RGB. */
+    const size_t max_size = QOI_HEADER_SIZE + (size_t)w * h * 4 + sizeof(QOI_PADDING);
+    uint8_t* dst = malloc(max_size);
+    if (!dst)
+    {
+        return NULL;
+    }
+
+    size_t off = 0;
+    memcpy(dst, "qoif", 4);
+    off += 4;
+    qoi_write_32(dst, &off, w);
+    qoi_write_32(dst, &off, h);
+    dst[off++] = 3; /* channels. */
+    dst[off++] = 0; /* srgb. */
+
+    /* pixels are stored with alpha 255 as the decoder sees them. the index
+       starts zeroed with alpha 0, so black never matches an empty slot. */
+    uint32_t index[64] = {0};
+    uint32_t prev = 0xFF000000;
+    unsigned run = 0;
+
+    for (uint32_t y = 0; y < h; y++)
+    {
+        const uint32_t* row = pixels + (size_t)y * stride;
+
+        for (uint32_t x = 0; x < w; x++)
+        {
+            const uint32_t px = row[x] | 0xFF000000;
+
+            if (px == prev)
+            {
+                run++;
+                if (run == 62)
+                {
+                    dst[off++] = QOI_OP_RUN | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run)
+            {
+                dst[off++] = QOI_OP_RUN | (run - 1);
+                run = 0;
+            }
+
+            const uint8_t r = px, g = px >> 8, b = px >> 16;
+            const unsigned hash = qoi_hash(r, g, b);
+
+            if (index[hash] == px)
+            {
+                dst[off++] = QOI_OP_INDEX | hash;
+            }
+            else
+            {
+                index[hash] = px;
+
+                const int8_t vr = r - (uint8_t)prev;
+                const int8_t vg = g - (uint8_t)(prev >> 8);
+                const int8_t vb = b - (uint8_t)(prev >> 16);
+                const int8_t vg_r = vr - vg;
+                const int8_t vg_b = vb - vg;
+
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+                {
+                    dst[off++] = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+                }
+                else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8)
+                {
+                    dst[off++] = QOI_OP_LUMA | (vg + 32);
+                    dst[off++] = (vg_r + 8) << 4 | (vg_b + 8);
+                }
+                else
+                {
+                    dst[off++] = QOI_OP_RGB;
+                    dst[off++] = r;
+                    dst[off++] = g;
+                    dst[off++] = b;
+                }
+            }
+
+            prev = px;
+        }
+    }
+
+    if (run)
+    {
+        dst[off++] = QOI_OP_RUN | (run - 1);
+    }
+
+    memcpy(dst + off, QOI_PADDING, sizeof(QOI_PADDING));
+    off += sizeof(QOI_PADDING);
+
+    *out_size = off;
+    return dst;
+}
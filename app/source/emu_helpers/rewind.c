@@ -2,12 +2,24 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 
 struct RewindBuffer
 {
     void* data;
     size_t compressed;
     size_t uncompressed;
+
+    /* compressor used to create the frame. */
+    rewind_compressor compressor;
+    void* user;
+};
+
+/* ring of the most recent call times. */
+struct RewindLatencySamples
+{
+    uint64_t samples[REWIND_STATS_LATENCY_SAMPLES];
+    uint64_t count;
 };
 
 struct Rewind
@@ -20,23 +32,103 @@ struct Rewind
 
     rewind_compressor compressor;
     rewind_compressor_size compressor_size;
+    void* user;
+
+    const RewindSpill* spill; /* optional, frames are moved here when overwritten. */
+
+    /* running totals of the frames in memory. */
+    size_t compressed_total;
+    size_t uncompressed_total;
+    size_t ratio_histogram[REWIND_STATS_RATIO_BUCKETS];
+
+    struct RewindLatencySamples push_latency;
+    struct RewindLatencySamples pop_latency;
+    struct RewindLatencySamples get_latency;
 };
 
 // these are used if no compressor is provided.
-static size_t rewind_dummy_compressor_size(size_t size)
+static size_t rewind_dummy_compressor_size(void* user, size_t size)
 {
     return size;
 }
 
-static size_t rewind_dummy_compressor(const void* src_data, void* dst_data, size_t src_size, size_t dst_size, bool inflate_mode)
+static size_t rewind_dummy_compressor(void* user, const void* src_data, void* dst_data, size_t src_size, size_t dst_size, bool inflate_mode)
 {
     assert(src_size == dst_size);
     memcpy(dst_data, src_data, src_size);
     return src_size;
 }
 
-static void rewindbuffer_free(struct RewindBuffer* rwb)
+static uint64_t rewind_get_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void rewind_latency_add(struct RewindLatencySamples* latency, uint64_t ns)
+{
+    latency->samples[latency->count % REWIND_STATS_LATENCY_SAMPLES] = ns;
+    latency->count++;
+}
+
+static int rewind_latency_compare(const void* a, const void* b)
+{
+    const uint64_t lhs = *(const uint64_t*)a;
+    const uint64_t rhs = *(const uint64_t*)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static void rewind_latency_get(const struct RewindLatencySamples* latency, RewindLatency* out)
+{
+    memset(out, 0, sizeof(*out));
+    out->count = latency->count;
+
+    const size_t count = latency->count < REWIND_STATS_LATENCY_SAMPLES ? latency->count : REWIND_STATS_LATENCY_SAMPLES;
+    if (!count)
+    {
+        return;
+    }
+
+    uint64_t sorted[REWIND_STATS_LATENCY_SAMPLES];
+    memcpy(sorted, latency->samples, count * sizeof(*sorted));
+    qsort(sorted, count, sizeof(*sorted), rewind_latency_compare);
+
+    out->p50_ns = sorted[(count - 1) * 50 / 100];
+    out->p90_ns = sorted[(count - 1) * 90 / 100];
+    out->p99_ns = sorted[(count - 1) * 99 / 100];
+    out->max_ns = sorted[count - 1];
+}
+
+static size_t rewind_get_ratio_bucket(const struct RewindBuffer* rwb)
+{
+    const size_t bucket = rwb->compressed * REWIND_STATS_RATIO_BUCKETS / rwb->uncompressed;
+    return bucket < REWIND_STATS_RATIO_BUCKETS ? bucket : REWIND_STATS_RATIO_BUCKETS - 1;
+}
+
+static void rewind_stats_add(Rewind* rw, const struct RewindBuffer* rwb)
+{
+    rw->compressed_total += rwb->compressed;
+    rw->uncompressed_total += rwb->uncompressed;
+    rw->ratio_histogram[rewind_get_ratio_bucket(rwb)]++;
+}
+
+static void rewind_stats_remove(Rewind* rw, const struct RewindBuffer* rwb)
+{
+    if (!rwb->data)
+    {
+        return;
+    }
+
+    rw->compressed_total -= rwb->compressed;
+    rw->uncompressed_total -= rwb->uncompressed;
+    rw->ratio_histogram[rewind_get_ratio_bucket(rwb)]--;
+}
+
+static void rewindbuffer_free(Rewind* rw, struct RewindBuffer* rwb)
 {
+    rewind_stats_remove(rw, rwb);
+
     if (rwb->data)
     {
         free(rwb->data);
@@ -44,6 +136,20 @@ static void rewindbuffer_free(struct RewindBuffer* rwb)
     memset(rwb, 0, sizeof(*rwb));
 }
 
+static size_t rewind_get_spill_count(const Rewind* rw)
+{
+    return rw->spill ? rw->spill->get_count(rw->spill->user) : 0;
+}
+
+// hands the frame over to the spill, the frame is cleared even on failure.
+static bool rewindbuffer_spill(Rewind* rw, struct RewindBuffer* rwb)
+{
+    rewind_stats_remove(rw, rwb);
+    const bool result = rw->spill->push(rw->spill->user, rwb->data, rwb->compressed, rwb->uncompressed, rwb->compressor, rwb->user);
+    memset(rwb, 0, sizeof(*rwb));
+    return result;
+}
+
 // converts 0 based index to relative.
 static size_t rewind_get_starting_index(const Rewind* rw, size_t index)
 {
@@ -60,7 +166,7 @@ static bool rewind_get_internal(Rewind* rw, size_t index, void* data, size_t siz
         return false;
     }
 
-    const size_t result = rw->compressor(rwb->data, data, rwb->compressed, rwb->uncompressed, true);
+    const size_t result = rwb->compressor(rwb->user, rwb->data, data, rwb->compressed, rwb->uncompressed, true);
     if (!result || result != rwb->uncompressed)
     {
         assert(!"failed to uncompress");
@@ -70,9 +176,9 @@ static bool rewind_get_internal(Rewind* rw, size_t index, void* data, size_t siz
     return true;
 }
 
-Rewind* rewind_init(size_t size, size_t frames_wanted, rewind_compressor compressor, rewind_compressor_size compressor_size)
+Rewind* rewind_init(size_t size, size_t frames_wanted, rewind_compressor compressor, rewind_compressor_size compressor_size, void* user)
 {
-    if (!size || !frames_wanted || (compressor && !compressor_size) || (!compressor && compressor_size))
+    if (!size || !frames_wanted)
     {
         return NULL;
     }
@@ -85,10 +191,8 @@ Rewind* rewind_init(size_t size, size_t frames_wanted, rewind_compressor compres
 
     rw->max = frames_wanted;
     rw->frames = calloc(rw->max, sizeof(*rw->frames));
-    rw->compressor = compressor ? compressor : rewind_dummy_compressor;
-    rw->compressor_size = compressor_size ? compressor_size : rewind_dummy_compressor_size;
 
-    if (!rw->frames)
+    if (!rw->frames || !rewind_set_compressor(rw, compressor, compressor_size, user))
     {
         rewind_close(rw);
         return NULL;
@@ -108,7 +212,7 @@ void rewind_close(Rewind* rw)
     {
         for (size_t i = 0; i < rw->max; i++)
         {
-            rewindbuffer_free(&rw->frames[i]);
+            rewindbuffer_free(rw, &rw->frames[i]);
         }
 
         free(rw->frames);
@@ -122,59 +226,156 @@ void rewind_reset(Rewind* rw)
 {
     for (size_t i = 0; i < rw->max; i++)
     {
-        rewindbuffer_free(&rw->frames[i]);
+        rewindbuffer_free(rw, &rw->frames[i]);
+    }
+
+    if (rewind_get_spill_count(rw))
+    {
+        rw->spill->remove_after(rw->spill->user, 0);
     }
 
     rw->count = 0;
     rw->index = 0;
 }
 
+bool rewind_set_compressor(Rewind* rw, rewind_compressor compressor, rewind_compressor_size compressor_size, void* user)
+{
+    if (!rw || (compressor && !compressor_size) || (!compressor && compressor_size))
+    {
+        return false;
+    }
+
+    rw->compressor = compressor ? compressor : rewind_dummy_compressor;
+    rw->compressor_size = compressor_size ? compressor_size : rewind_dummy_compressor_size;
+    rw->user = user;
+    return true;
+}
+
+void rewind_set_spill(Rewind* rw, const RewindSpill* spill)
+{
+    rw->spill = spill;
+}
+
+bool rewind_spill_all(Rewind* rw)
+{
+    if (!rw || !rw->spill)
+    {
+        return false;
+    }
+
+    bool result = true;
+    for (size_t i = 0; i < rw->count; i++)
+    {
+        if (!rewindbuffer_spill(rw, &rw->frames[rewind_get_starting_index(rw, i)]))
+        {
+            result = false;
+        }
+    }
+
+    rw->count = 0;
+    return result;
+}
+
 bool rewind_push(Rewind* rw, const void* data, size_t size, size_t* compressed)
 {
-    if (!rw || !data)
+    const uint64_t start = rewind_get_time_ns();
+    size_t compressed_size;
+    void* compressed_data = rewind_compress(rw, data, size, &compressed_size);
+    if (!compressed_data)
     {
         return false;
     }
 
-    /* allocate bound space for new compressed state. */
-    struct RewindBuffer new_frame = {0};
-    new_frame.uncompressed = size;
+    if (!rewind_push_compressed(rw, compressed_data, compressed_size, size))
+    {
+        return false;
+    }
+
+    rewind_add_push_time(rw, rewind_get_time_ns() - start);
+
+    if (compressed)
+    {
+        *compressed = compressed_size;
+    }
+
+    return true;
+}
+
+void* rewind_compress(const Rewind* rw, const void* data, size_t size, size_t* compressed)
+{
+    if (!rw || !data || !compressed)
+    {
+        return NULL;
+    }
 
-    const size_t bound = rw->compressor_size(new_frame.uncompressed);
-    new_frame.data = malloc(bound);
-    if (!new_frame.data || !bound)
+    /* allocate bound space for new compressed state. */
+    const size_t bound = rw->compressor_size(rw->user, size);
+    void* compressed_data = malloc(bound);
+    if (!compressed_data || !bound)
     {
         assert(!"failed to malloc new frame data");
-        return false;
+        free(compressed_data);
+        return NULL;
     }
 
-    new_frame.compressed = rw->compressor(data, new_frame.data, new_frame.uncompressed, bound, false);
-    assert(new_frame.compressed != 0);
+    *compressed = rw->compressor(rw->user, data, compressed_data, size, bound, false);
+    if (!*compressed)
+    {
+        assert(!"failed to compress");
+        free(compressed_data);
+        return NULL;
+    }
 
     /* shrink data using realloc. */
-    new_frame.data = realloc(new_frame.data, new_frame.compressed);
-    if (!new_frame.data)
+    void* shrunk_data = realloc(compressed_data, *compressed);
+    if (!shrunk_data)
     {
         assert(!"failed to realloc new frame data");
-        rewindbuffer_free(&new_frame);
+        free(compressed_data);
+        return NULL;
+    }
+
+    return shrunk_data;
+}
+
+bool rewind_push_compressed(Rewind* rw, void* compressed_data, size_t compressed, size_t size)
+{
+    if (!rw || !compressed_data)
+    {
+        free(compressed_data);
         return false;
     }
 
-    /* remove old frame if data exists. */
-    rewindbuffer_free(&rw->frames[rw->index]);
+    struct RewindBuffer new_frame = {0};
+    new_frame.data = compressed_data;
+    new_frame.compressed = compressed;
+    new_frame.uncompressed = size;
+    new_frame.compressor = rw->compressor;
+    new_frame.user = rw->user;
+
+    /* remove old frame if data exists, moving it to the spill if set. */
+    if (rw->spill && rw->frames[rw->index].data)
+    {
+        rewindbuffer_spill(rw, &rw->frames[rw->index]);
+    }
+    else
+    {
+        rewindbuffer_free(rw, &rw->frames[rw->index]);
+    }
 
     rw->frames[rw->index] = new_frame;
+    rewind_stats_add(rw, &new_frame);
     rw->index = (rw->index + 1) % rw->max;
     rw->count = rw->count < rw->max ? rw->count + 1 : rw->max;
 
-    if (compressed)
-    {
-        *compressed = new_frame.compressed;
-    }
-
     return true;
 }
 
+void rewind_add_push_time(Rewind* rw, uint64_t ns)
+{
+    rewind_latency_add(&rw->push_latency, ns);
+}
+
 bool rewind_pop(Rewind* rw, void* data, size_t size)
 {
     if (!rw || !data)
@@ -182,8 +383,22 @@ bool rewind_pop(Rewind* rw, void* data, size_t size)
         return false;
     }
 
+    const uint64_t start = rewind_get_time_ns();
+
     if (rw->count == 0)
     {
+        const size_t spill_count = rewind_get_spill_count(rw);
+        if (spill_count)
+        {
+            if (!rw->spill->get(rw->spill->user, spill_count - 1, data, size) || !rw->spill->remove_after(rw->spill->user, spill_count - 1))
+            {
+                return false;
+            }
+
+            rewind_latency_add(&rw->pop_latency, rewind_get_time_ns() - start);
+            return true;
+        }
+
         assert(!"rewind pop called with no frames stored!");
         return false;
     }
@@ -194,10 +409,11 @@ bool rewind_pop(Rewind* rw, void* data, size_t size)
         return false;
     }
 
-    rewindbuffer_free(&rw->frames[index]);
+    rewindbuffer_free(rw, &rw->frames[index]);
     rw->index = index;
     rw->count--;
 
+    rewind_latency_add(&rw->pop_latency, rewind_get_time_ns() - start);
     return true;
 }
 
@@ -208,18 +424,51 @@ bool rewind_get(Rewind* rw, size_t index, void* data, size_t size)
         return false;
     }
 
-    if (index >= rw->count)
+    const uint64_t start = rewind_get_time_ns();
+    const size_t spill_count = rewind_get_spill_count(rw);
+    bool result;
+
+    if (index < spill_count)
     {
-        assert(!"out of bounds rewind_remove_after()");
-        return false;
+        result = rw->spill->get(rw->spill->user, index, data, size);
     }
+    else
+    {
+        index -= spill_count;
+        if (index >= rw->count)
+        {
+            assert(!"out of bounds rewind_get()");
+            return false;
+        }
 
-    index = rewind_get_starting_index(rw, index);
-    return rewind_get_internal(rw, index, data, size);
+        index = rewind_get_starting_index(rw, index);
+        result = rewind_get_internal(rw, index, data, size);
+    }
+
+    if (result)
+    {
+        rewind_latency_add(&rw->get_latency, rewind_get_time_ns() - start);
+    }
+
+    return result;
 }
 
 bool rewind_remove_after(Rewind* rw, size_t index)
 {
+    const size_t spill_count = rewind_get_spill_count(rw);
+    if (index < spill_count)
+    {
+        /* everything in memory is newer than the spill. */
+        for (size_t i = 0; i < rw->count; i++)
+        {
+            rewindbuffer_free(rw, &rw->frames[rewind_get_starting_index(rw, i)]);
+        }
+
+        rw->count = 0;
+        return rw->spill->remove_after(rw->spill->user, index);
+    }
+
+    index -= spill_count;
     if (index >= rw->count)
     {
         assert(!"out of bounds rewind_remove_after()");
@@ -230,7 +479,7 @@ bool rewind_remove_after(Rewind* rw, size_t index)
 
     for (size_t i = index; i != rw->index; i = (i + 1) % rw->max)
     {
-        rewindbuffer_free(&rw->frames[i]);
+        rewindbuffer_free(rw, &rw->frames[i]);
         rw->count--;
     }
 
@@ -240,11 +489,18 @@ bool rewind_remove_after(Rewind* rw, size_t index)
 
 size_t rewind_get_count(const Rewind* rw)
 {
-    return rw->count;
+    return rewind_get_spill_count(rw) + rw->count;
 }
 
 bool rewind_get_size(const Rewind* rw, size_t index, size_t* compressed, size_t* uncompressed)
 {
+    const size_t spill_count = rewind_get_spill_count(rw);
+    if (index < spill_count)
+    {
+        return rw->spill->get_size(rw->spill->user, index, compressed, uncompressed);
+    }
+
+    index -= spill_count;
     if (index >= rw->count)
     {
         assert(!"out of bounds rewind_get_size()");
@@ -281,12 +537,19 @@ size_t rewind_get_allocated_size(const Rewind* rw, bool include_internal_buffers
         size += rw->max * sizeof(*rw->frames);
     }
 
-    for (size_t i = 0; i < rw->count; i++)
-    {
-        size_t compressed;
-        rewind_get_size(rw, i, &compressed, NULL);
-        size += compressed;
-    }
+    return size + rw->compressed_total;
+}
 
-    return size;
+void rewind_get_stats(const Rewind* rw, RewindStats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->count = rw->count;
+    stats->spill_count = rewind_get_spill_count(rw);
+    stats->compressed = rw->compressed_total;
+    stats->uncompressed = rw->uncompressed_total;
+    memcpy(stats->ratio_histogram, rw->ratio_histogram, sizeof(stats->ratio_histogram));
+
+    rewind_latency_get(&rw->push_latency, &stats->push);
+    rewind_latency_get(&rw->pop_latency, &stats->pop);
+    rewind_latency_get(&rw->get_latency, &stats->get);
 }
@@ -14,6 +14,9 @@ struct RewindBar {
 
 #define SHOW_TIME 0
 
+// how many entries either side of the visible ones to decode ahead of time.
+static const int PREFETCH_DISTANCE = 2;
+
 static struct RewindBar g_bar;
 
 #if SHOW_TIME
@@ -34,17 +37,56 @@ static void rewind_bar_change_direction(int v) {
     }
 }
 
-static auto render_entry(NVGcontext* vg, Theme* theme, Menu* app, int index, Vec4 rect, const Vec4& bar) -> const RewindBarTexture* {
-    const auto texture = app->m_rewind_bar_textures.GetNext();
+// returns the texture for the entry, decoding it if it's not already cached.
+static auto load_entry(Menu* app, int index) -> RewindBarTexture* {
+    auto& cache = app->m_rewind_bar_textures;
+    if (auto texture = cache.Find(index)) {
+        texture->last_used = cache.frame;
+        return texture;
+    }
+
+    const auto texture = cache.GetLru();
     if (!texture) {
         return {};
     }
 
+    texture->index = -1;
     if (!rewind_get(app->rewind, index, app->rewind_buffer, app->rewind_buffer_size)) {
         log_write("failed to get rewind entry: %d cursor: %d\n", index, g_bar.cursor);
         return {};
     }
 
+    rewind_frame_decode((u32*)app->rewind_frame_buffer, app->rewind_pixel_buffer, SMS_SCREEN_WIDTH, SMS_SCREEN_HEIGHT);
+    app->emulator_update_texture_pixels(app, texture->handle, app->rewind_frame_buffer);
+    texture->index = index;
+    texture->last_used = cache.frame;
+
+    return texture;
+}
+
+// decodes a single uncached entry near the cursor, closest first.
+// only one is done per frame so that scrolling does not stall.
+static void prefetch_entry(Menu* app, int visible_left, int visible_right) {
+    const auto max_distance = std::max(visible_left, visible_right) + PREFETCH_DISTANCE;
+
+    for (int i = 1; i <= max_distance; i++) {
+        for (const auto index : { g_bar.cursor - i, g_bar.cursor + i }) {
+            if (index < 0 || index >= g_bar.count || app->m_rewind_bar_textures.Find(index)) {
+                continue;
+            }
+
+            load_entry(app, index);
+            return;
+        }
+    }
+}
+
+static auto render_entry(NVGcontext* vg, Theme* theme, Menu* app, int index, Vec4 rect, const Vec4& bar) -> const RewindBarTexture* {
+    const auto texture = load_entry(app, index);
+    if (!texture) {
+        return {};
+    }
+
     if (index == g_bar.cursor) {
         const float pad = 2;
         rect.x -= pad;
@@ -61,7 +103,6 @@ static auto render_entry(NVGcontext* vg, Theme* theme, Menu* app, int index, Vec
     gfx::drawTextArgs(vg, center_x, center_y, font_size, NVG_ALIGN_MIDDLE | NVG_ALIGN_CENTER, theme->GetColour(ThemeEntryID_TEXT), "%.1fs", (double)(g_bar.count - 1 - index) * (double)app->rewind_keyframe_interval / 60.0);
 #endif
 
-    app->emulator_update_texture_pixels(app, texture->handle, app->rewind_pixel_buffer);
     gfx::drawImage(vg, rect, texture->handle);
 
     return texture;
@@ -77,8 +118,13 @@ static void rewind_bar_set_open_internal(Menu* app, bool enable, bool pop_last_s
 
         if (g_bar.enable) {
             app->rewind_push_new_frame(app);
+            // wait for the worker to finish pushing, the emulator is paused
+            // whilst the bar is open so no new frames will be pushed.
+            app->rewind_worker.Flush();
             g_bar.count = rewind_get_count(app->rewind);
             g_bar.cursor = g_bar.count - 1;
+            // entries may have changed since the bar was last open.
+            app->m_rewind_bar_textures.Clear();
         } else {
             // rewind pushes the current frame to the buffer when the bar is opened.
             // if we are closing the bar as we did not load a state, then we want to
@@ -119,9 +165,9 @@ void rewind_bar_button(Menu* app, enum RewindBarButton button) {
             rewind_get(app->rewind, g_bar.cursor, app->rewind_buffer, app->rewind_buffer_size);
             rewind_remove_after(app->rewind, g_bar.cursor);
 
-            // copy new frame to front and back buffer.
-            memcpy(app->pixel_buffer[0], app->rewind_pixel_buffer, app->rewind_pixel_buffer_size);
-            memcpy(app->pixel_buffer[1], app->rewind_pixel_buffer, app->rewind_pixel_buffer_size);
+            // decode new frame to front and back buffer.
+            rewind_frame_decode((u32*)app->pixel_buffer[0], app->rewind_pixel_buffer, SMS_SCREEN_WIDTH, SMS_SCREEN_HEIGHT);
+            memcpy(app->pixel_buffer[1], app->pixel_buffer[0], app->pixel_buffer_size);
 
             // load savestate and disable the menu bar.
             SMS_loadstate(&app->sms, app->rewind_state_buffer, app->rewind_state_buffer_size, &app->rewind_state_config);
@@ -148,6 +194,7 @@ void rewind_bar_render(NVGcontext* vg, Theme* theme, Menu* app) {
     }
 
     const Vec4 viewport = { 0, 0, SMS_SCREEN_WIDTH, SMS_SCREEN_HEIGHT };
+    app->m_rewind_bar_textures.frame++;
 
     nvgSave(vg);
     nvgScale(vg, SCREEN_WIDTH / viewport.w, SCREEN_HEIGHT / viewport.h);
@@ -178,6 +225,7 @@ void rewind_bar_render(NVGcontext* vg, Theme* theme, Menu* app) {
     center_box.y = bar.y + pady_top;
 
     // draw left
+    int visible_left = 0;
     Vec4 box = center_box;
     for (int i = g_bar.cursor - 1; i >= 0; i--) {
         box.x -= box.w + padx;
@@ -186,9 +234,11 @@ void rewind_bar_render(NVGcontext* vg, Theme* theme, Menu* app) {
         }
 
         render_entry(vg, theme, app, i, box, bar);
+        visible_left++;
     }
 
     // draw right
+    int visible_right = 0;
     box = center_box;
     for (int i = g_bar.cursor + 1; i < g_bar.count; i++) {
         box.x += box.w + padx;
@@ -197,6 +247,7 @@ void rewind_bar_render(NVGcontext* vg, Theme* theme, Menu* app) {
         }
 
         render_entry(vg, theme, app, i, box, bar);
+        visible_right++;
     }
 
     // draw center
@@ -210,8 +261,13 @@ void rewind_bar_render(NVGcontext* vg, Theme* theme, Menu* app) {
     rr.w = (float)SMS_SCREEN_WIDTH * scale;
     rr.x = (viewport.w - rr.w) / 2;
 
-    gfx::drawImage(vg, rr, texture->handle);
+    if (texture) {
+        gfx::drawImage(vg, rr, texture->handle);
+    }
 
     nvgRestore(vg);
+
+    // decode the next entries whilst the cursor is idle.
+    prefetch_entry(app, visible_left, visible_right);
 }
 } // namespace sphaira
@@ -0,0 +1,134 @@
+#include "emu_helpers/rewind_codec.h"
+#include <lz4.h>
+#include <lz4hc.h>
+#include <string.h>
+#include <assert.h>
+
+// how many times faster (and worse) than the default lz4.
+#define LZ4_FAST_DEFAULT_ACCELERATION 8
+// level 9 is lz4hc default, though it is too slow for 60fps states.
+#define LZ4HC_DEFAULT_LEVEL 4
+// lz4 only looks back 64KiB, anything larger is ignored.
+#define LZ4_DICT_MAX_SIZE (64 * 1024)
+
+static const char* const CODEC_NAMES[RewindCodecType_MAX] =
+{
+    [RewindCodecType_LZ4] = "LZ4",
+    [RewindCodecType_LZ4_FAST] = "LZ4 Fast",
+    [RewindCodecType_LZ4HC] = "LZ4HC",
+    [RewindCodecType_LZ4_DICT] = "LZ4 Dictionary",
+};
+
+static size_t lz4_result(int result)
+{
+    return result <= 0 ? 0 : (size_t)result;
+}
+
+static const char* get_dict(const RewindCodec* codec, int* dict_size)
+{
+    const char* dict = (const char*)codec->dict;
+    size_t size = codec->dict_size;
+
+    if (size > LZ4_DICT_MAX_SIZE)
+    {
+        dict += size - LZ4_DICT_MAX_SIZE;
+        size = LZ4_DICT_MAX_SIZE;
+    }
+
+    *dict_size = (int)size;
+    return dict;
+}
+
+static size_t compress_dict(const RewindCodec* codec, const void* src_data, void* dst_data, size_t src_size, size_t dst_size)
+{
+    int dict_size;
+    const char* dict = get_dict(codec, &dict_size);
+
+    LZ4_stream_t stream;
+    LZ4_initStream(&stream, sizeof(stream));
+    if (dict_size)
+    {
+        LZ4_loadDict(&stream, dict, dict_size);
+    }
+
+    return lz4_result(LZ4_compress_fast_continue(&stream, (const char*)src_data, (char*)dst_data, src_size, dst_size, 1));
+}
+
+static size_t decompress_dict(const RewindCodec* codec, const void* src_data, void* dst_data, size_t src_size, size_t dst_size)
+{
+    int dict_size;
+    const char* dict = get_dict(codec, &dict_size);
+
+    return lz4_result(LZ4_decompress_safe_usingDict((const char*)src_data, (char*)dst_data, src_size, dst_size, dict, dict_size));
+}
+
+void rewind_codec_init(RewindCodec* codec, RewindCodecType type)
+{
+    memset(codec, 0, sizeof(*codec));
+    codec->type = type;
+
+    switch (type)
+    {
+        case RewindCodecType_LZ4_FAST:
+            codec->level = LZ4_FAST_DEFAULT_ACCELERATION;
+            break;
+
+        case RewindCodecType_LZ4HC:
+            codec->level = LZ4HC_DEFAULT_LEVEL;
+            break;
+
+        default:
+            break;
+    }
+}
+
+const char* rewind_codec_get_name(RewindCodecType type)
+{
+    if (type < 0 || type >= RewindCodecType_MAX)
+    {
+        return "Unknown";
+    }
+
+    return CODEC_NAMES[type];
+}
+
+size_t rewind_codec_compressor_size(void* user, size_t src_size)
+{
+    return LZ4_compressBound(src_size);
+}
+
+size_t rewind_codec_compressor(void* user, const void* src_data, void* dst_data, size_t src_size, size_t dst_size, bool inflate_mode)
+{
+    const RewindCodec* codec = (const RewindCodec*)user;
+
+    if (codec->type == RewindCodecType_LZ4_DICT)
+    {
+        if (inflate_mode)
+        {
+            return decompress_dict(codec, src_data, dst_data, src_size, dst_size);
+        }
+        return compress_dict(codec, src_data, dst_data, src_size, dst_size);
+    }
+
+    // all other codecs produce a standard lz4 block.
+    if (inflate_mode)
+    {
+        return lz4_result(LZ4_decompress_safe((const char*)src_data, (char*)dst_data, src_size, dst_size));
+    }
+
+    switch (codec->type)
+    {
+        case RewindCodecType_LZ4:
+            return lz4_result(LZ4_compress_default((const char*)src_data, (char*)dst_data, src_size, dst_size));
+
+        case RewindCodecType_LZ4_FAST:
+            return lz4_result(LZ4_compress_fast((const char*)src_data, (char*)dst_data, src_size, dst_size, codec->level));
+
+        case RewindCodecType_LZ4HC:
+            return lz4_result(LZ4_compress_HC((const char*)src_data, (char*)dst_data, src_size, dst_size, codec->level));
+
+        default:
+            assert(!"unknown rewind codec");
+            return 0;
+    }
+}
@@ -0,0 +1,361 @@
+#include "emu_helpers/rewind_disk.hpp"
+#include "defines.hpp"
+#include "log.hpp"
+#include <cstring>
+
+namespace sphaira {
+namespace {
+
+constexpr u32 FILE_MAGIC = 0x53445752; // RWDS
+constexpr u32 FILE_VERSION = 1;
+constexpr u32 ENTRY_MAGIC = 0x45445752; // RWDE
+
+struct FileHeader {
+    u32 magic;
+    u32 version;
+    u64 frame_size;
+    // crc32 of the LZ4_DICT dictionary, frames can't be decoded with another one.
+    u32 dict_crc;
+    u32 reserved;
+};
+
+auto GetDictCrc(std::span<const RewindCodec> codecs) -> u32 {
+    if (codecs.size() <= RewindCodecType_LZ4_DICT) {
+        return 0;
+    }
+
+    const auto& codec = codecs[RewindCodecType_LZ4_DICT];
+    if (!codec.dict || !codec.dict_size) {
+        return 0;
+    }
+
+    return crc32CalculateWithSeed(0, codec.dict, codec.dict_size);
+}
+
+// written before the compressed data of every frame.
+struct EntryHeader {
+    u32 magic;
+    u32 compressed;
+    u32 codec;
+    u32 reserved;
+};
+
+} // namespace
+
+RewindDisk::~RewindDisk() {
+    Exit(true);
+}
+
+Result RewindDisk::Init(const fs::FsPath& path, size_t frame_size, s64 max_size, std::span<RewindCodec> codecs, bool resume) {
+    Exit(true);
+
+    m_path = path;
+    m_frame_size = frame_size;
+    m_max_size = max_size;
+    m_codecs = codecs;
+    m_entries.clear();
+    m_pending_index = 0;
+    m_end_offset = sizeof(FileHeader);
+    m_writing = false;
+    m_write_cancelled = false;
+    m_failed = false;
+    m_quit = false;
+
+    m_fs.CreateDirectoryRecursivelyWithPath(m_path);
+    if (!resume || R_FAILED(LoadIndex())) {
+        m_file.Close();
+        m_entries.clear();
+        m_end_offset = sizeof(FileHeader);
+
+        m_fs.DeleteFile(m_path);
+        R_TRY(m_fs.CreateFile(m_path));
+        R_TRY(m_fs.OpenFile(m_path, FsOpenMode_Read | FsOpenMode_Write | FsOpenMode_Append, &m_file));
+
+        const FileHeader header{FILE_MAGIC, FILE_VERSION, m_frame_size, GetDictCrc(m_codecs), 0};
+        R_TRY(m_file.Write(0, &header, sizeof(header), FsWriteOption_None));
+    }
+
+    m_pending_index = m_entries.size();
+    log_write("[rewind] disk opened with %zu frames\n", m_entries.size());
+
+    m_spill.user = this;
+    m_spill.push = SpillPush;
+    m_spill.get_count = SpillGetCount;
+    m_spill.get = SpillGet;
+    m_spill.get_size = SpillGetSize;
+    m_spill.remove_after = SpillRemoveAfter;
+
+    mutexInit(&m_mutex);
+    condvarInit(&m_can_work);
+
+    // lowest priority, writing to the sd card can take a while.
+    R_TRY(threadCreate(&m_thread, ThreadFunc, this, nullptr, 1024*32, 0x3F, 2));
+    if (R_FAILED(threadStart(&m_thread))) {
+        threadClose(&m_thread);
+        m_file.Close();
+        R_THROW(0x1);
+    }
+
+    m_running = true;
+    R_SUCCEED();
+}
+
+void RewindDisk::Exit(bool keep) {
+    if (!m_running) {
+        return;
+    }
+
+    mutexLock(&m_mutex);
+    m_quit = true;
+    condvarWakeAll(&m_can_work);
+    mutexUnlock(&m_mutex);
+
+    threadWaitForExit(&m_thread);
+    threadClose(&m_thread);
+
+    // only left over if a write failed.
+    for (auto& e : m_entries) {
+        if (e.pending) {
+            free(e.pending);
+        }
+    }
+
+    m_file.Close();
+    if (!keep) {
+        m_fs.DeleteFile(m_path);
+    }
+
+    m_entries = {};
+    m_read_buf = {};
+    m_running = false;
+}
+
+// walks the entry headers of an existing file, stopping at the first bad entry.
+Result RewindDisk::LoadIndex() {
+    R_TRY(m_fs.OpenFile(m_path, FsOpenMode_Read | FsOpenMode_Write | FsOpenMode_Append, &m_file));
+
+    s64 file_size;
+    R_TRY(m_file.GetSize(&file_size));
+
+    FileHeader header;
+    u64 bytes_read;
+    R_TRY(m_file.Read(0, &header, sizeof(header), 0, &bytes_read));
+    R_UNLESS(bytes_read == sizeof(header), 0x1);
+    R_UNLESS(header.magic == FILE_MAGIC && header.version == FILE_VERSION && header.frame_size == m_frame_size, 0x1);
+    // the benchmark may have replaced the dictionary since the file was written.
+    R_UNLESS(header.dict_crc == GetDictCrc(m_codecs), 0x1);
+
+    s64 off = sizeof(header);
+    while (off + (s64)sizeof(EntryHeader) <= file_size) {
+        EntryHeader entry;
+        R_TRY(m_file.Read(off, &entry, sizeof(entry), 0, &bytes_read));
+
+        if (bytes_read != sizeof(entry) || entry.magic != ENTRY_MAGIC || entry.codec >= m_codecs.size()) {
+            break;
+        }
+
+        const auto next = off + (s64)sizeof(entry) + entry.compressed;
+        if (next > file_size) {
+            break;
+        }
+
+        m_entries.emplace_back(off, entry.compressed, entry.codec, nullptr);
+        off = next;
+    }
+
+    // remove partially written entries.
+    m_end_offset = off;
+    if (off != file_size) {
+        R_TRY(m_file.SetSize(off));
+    }
+
+    R_SUCCEED();
+}
+
+void RewindDisk::ThreadFunc(void* arg) {
+    static_cast<RewindDisk*>(arg)->ThreadLoop();
+}
+
+void RewindDisk::ThreadLoop() {
+    for (;;) {
+        Entry e;
+        {
+            SCOPED_MUTEX(&m_mutex);
+            while ((m_pending_index == m_entries.size() || m_failed) && !m_quit) {
+                condvarWait(&m_can_work, &m_mutex);
+            }
+
+            // write all pending entries before exiting.
+            if (m_pending_index == m_entries.size() || m_failed) {
+                break;
+            }
+
+            e = m_entries[m_pending_index];
+            m_writing = true;
+            m_write_cancelled = false;
+        }
+
+        // the lock is not held whilst writing, SpillPush() is called by the
+        // rewind worker whilst it holds the lock that the main thread takes
+        // every frame, so it must never wait on the sd card.
+        const EntryHeader header{ENTRY_MAGIC, e.compressed, e.codec, 0};
+
+        auto rc = m_file.Write(e.offset, &header, sizeof(header), FsWriteOption_None);
+        if (R_SUCCEEDED(rc)) {
+            rc = m_file.Write(e.offset + sizeof(header), e.pending, e.compressed, FsWriteOption_None);
+        }
+
+        SCOPED_MUTEX(&m_mutex);
+        m_writing = false;
+
+        // the entry was removed whilst it was written, see RemoveAfter().
+        if (m_write_cancelled) {
+            free(e.pending);
+
+            // everything before the first pending entry has been written.
+            const auto end = m_pending_index < m_entries.size() ? m_entries[m_pending_index].offset : m_end_offset;
+            if (R_FAILED(m_file.SetSize(end))) {
+                log_write("[rewind] failed to truncate disk\n");
+            }
+            continue;
+        }
+
+        if (R_FAILED(rc)) {
+            // keep the entry in memory so that it can still be read.
+            log_write("[rewind] failed to write to disk: 0x%X\n", rc);
+            m_failed = true;
+            continue;
+        }
+
+        free(e.pending);
+        m_entries[m_pending_index].pending = nullptr;
+        m_pending_index++;
+    }
+}
+
+void RewindDisk::RemoveAfter(size_t index) {
+    for (size_t i = index; i < m_entries.size(); i++) {
+        // the writer owns the data until it is done with it.
+        if (m_writing && i == m_pending_index) {
+            m_write_cancelled = true;
+        } else if (m_entries[i].pending) {
+            free(m_entries[i].pending);
+        }
+    }
+
+    m_end_offset = index < m_entries.size() ? m_entries[index].offset : m_end_offset;
+    m_entries.resize(index);
+    m_pending_index = std::min(m_pending_index, index);
+
+    // the file is append-only, so drop everything after the new end.
+    if (R_FAILED(m_file.SetSize(m_end_offset))) {
+        log_write("[rewind] failed to truncate disk\n");
+    }
+}
+
+bool RewindDisk::SpillPush(void* user, void* data, size_t compressed, size_t size, rewind_compressor compressor, void* compressor_user) {
+    auto self = static_cast<RewindDisk*>(user);
+    SCOPED_MUTEX(&self->m_mutex);
+
+    // frames must be compressed with one of our codecs so they can be read back.
+    if (size != self->m_frame_size || compressor != rewind_codec_compressor || !compressor_user) {
+        free(data);
+        return false;
+    }
+
+    // every frame on disk is older than the frame being dropped, they are
+    // dropped too so that there is no gap in the history.
+    if (self->m_failed) {
+        if (!self->m_entries.empty()) {
+            log_write("[rewind] disk failed, dropping %zu frames on disk\n", self->m_entries.size());
+            self->RemoveAfter(0);
+        }
+        free(data);
+        return false;
+    }
+
+    // the file can only be appended to, so once full the oldest frames are
+    // dropped by starting the file again from this frame.
+    const auto entry_size = (s64)sizeof(EntryHeader) + (s64)compressed;
+    if (self->m_end_offset + entry_size > self->m_max_size) {
+        log_write("[rewind] disk is full, dropping %zu old frames\n", self->m_entries.size());
+        self->RemoveAfter(0);
+
+        if (self->m_end_offset + entry_size > self->m_max_size) {
+            free(data);
+            return false;
+        }
+    }
+
+    self->m_entries.emplace_back(self->m_end_offset, compressed, static_cast<const RewindCodec*>(compressor_user)->type, data);
+    self->m_end_offset += entry_size;
+    condvarWakeOne(&self->m_can_work);
+    return true;
+}
+
+size_t RewindDisk::SpillGetCount(void* user) {
+    auto self = static_cast<RewindDisk*>(user);
+    SCOPED_MUTEX(&self->m_mutex);
+    return self->m_entries.size();
+}
+
+bool RewindDisk::SpillGet(void* user, size_t index, void* data, size_t size) {
+    auto self = static_cast<RewindDisk*>(user);
+    SCOPED_MUTEX(&self->m_mutex);
+
+    if (index >= self->m_entries.size() || size != self->m_frame_size) {
+        return false;
+    }
+
+    const auto& e = self->m_entries[index];
+    const void* src = e.pending;
+
+    if (!src) {
+        self->m_read_buf.resize(e.compressed);
+
+        u64 bytes_read;
+        if (R_FAILED(self->m_file.Read(e.offset + sizeof(EntryHeader), self->m_read_buf.data(), e.compressed, 0, &bytes_read)) || bytes_read != e.compressed) {
+            log_write("[rewind] failed to read frame: %zu from disk\n", index);
+            return false;
+        }
+
+        src = self->m_read_buf.data();
+    }
+
+    return rewind_codec_compressor(&self->m_codecs[e.codec], src, data, e.compressed, size, true) == size;
+}
+
+bool RewindDisk::SpillGetSize(void* user, size_t index, size_t* compressed, size_t* uncompressed) {
+    auto self = static_cast<RewindDisk*>(user);
+    SCOPED_MUTEX(&self->m_mutex);
+
+    if (index >= self->m_entries.size()) {
+        return false;
+    }
+
+    if (compressed) {
+        *compressed = self->m_entries[index].compressed;
+    }
+    if (uncompressed) {
+        *uncompressed = self->m_frame_size;
+    }
+
+    return true;
+}
+
+bool RewindDisk::SpillRemoveAfter(void* user, size_t index) {
+    auto self = static_cast<RewindDisk*>(user);
+    SCOPED_MUTEX(&self->m_mutex);
+
+    if (index >= self->m_entries.size()) {
+        return false;
+    }
+
+    self->RemoveAfter(index);
+    // try writing again.
+    self->m_failed = false;
+    condvarWakeOne(&self->m_can_work);
+    return true;
+}
+
+} // namespace sphaira
@@ -0,0 +1,102 @@
+#include "emu_helpers/rewind_frame.h"
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned colour_distance(uint32_t a, uint32_t b)
+{
+    unsigned distance = 0;
+
+    for (int i = 0; i < 32; i += 8)
+    {
+        distance += abs((int)((a >> i) & 0xFF) - (int)((b >> i) & 0xFF));
+    }
+
+    return distance;
+}
+
+static uint8_t find_closest_colour(const uint32_t* palette, size_t count, uint32_t colour)
+{
+    uint8_t closest = 0;
+    unsigned closest_distance = ~0U;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const unsigned distance = colour_distance(palette[i], colour);
+        if (distance < closest_distance)
+        {
+            closest = i;
+            closest_distance = distance;
+        }
+    }
+
+    return closest;
+}
+
+size_t rewind_frame_get_size(size_t width, size_t height)
+{
+    return width * height + sizeof(uint32_t) * REWIND_FRAME_PALETTE_COUNT;
+}
+
+void rewind_frame_encode(void* dst, const uint32_t* pixels, size_t width, size_t height)
+{
+    uint8_t* indices = (uint8_t*)dst;
+    uint32_t palette[REWIND_FRAME_PALETTE_COUNT];
+    size_t count = 0;
+
+    /* most pixels are the same colour as the previous, so cache the last lookup. */
+    uint32_t last_colour = 0;
+    uint8_t last_index = 0;
+    int has_last = 0;
+
+    for (size_t i = 0; i < width * height; i++)
+    {
+        const uint32_t colour = pixels[i];
+
+        if (!has_last || colour != last_colour)
+        {
+            size_t j = 0;
+            for (; j < count; j++)
+            {
+                if (palette[j] == colour)
+                {
+                    break;
+                }
+            }
+
+            if (j < count)
+            {
+                last_index = j;
+            }
+            else if (count < REWIND_FRAME_PALETTE_COUNT)
+            {
+                palette[count] = colour;
+                last_index = count++;
+            }
+            else
+            {
+                last_index = find_closest_colour(palette, count, colour);
+            }
+
+            last_colour = colour;
+            has_last = 1;
+        }
+
+        indices[i] = last_index;
+    }
+
+    /* clear unused entries so that they compress well. */
+    memset(palette + count, 0, sizeof(palette) - count * sizeof(uint32_t));
+    memcpy(indices + width * height, palette, sizeof(palette));
+}
+
+void rewind_frame_decode(uint32_t* pixels, const void* src, size_t width, size_t height)
+{
+    const uint8_t* indices = (const uint8_t*)src;
+    uint32_t palette[REWIND_FRAME_PALETTE_COUNT];
+    memcpy(palette, indices + width * height, sizeof(palette));
+
+    for (size_t i = 0; i < width * height; i++)
+    {
+        pixels[i] = palette[indices[i]];
+    }
+}
@@ -0,0 +1,264 @@
+#include "emu_helpers/rewind_worker.hpp"
+#include "ui/types.hpp"
+#include "defines.hpp"
+#include "log.hpp"
+
+namespace sphaira {
+namespace {
+
+// number of frames each codec is measured on before picking one.
+constexpr u32 AUTO_SAMPLE_COUNT = 4;
+// compression happens on the worker every keyframe, so it can take a while.
+constexpr u64 AUTO_PUSH_BUDGET_NS = 8'000'000;
+// decompression happens on the main thread when scrolling the rewind bar.
+constexpr u64 AUTO_POP_BUDGET_NS = 4'000'000;
+
+} // namespace
+
+RewindWorker::~RewindWorker() {
+    Exit();
+}
+
+Result RewindWorker::Init(Rewind* rw, size_t slot_size) {
+    Exit();
+
+    m_rewind = rw;
+    m_slot_size = slot_size;
+    m_r_index = 0;
+    m_w_index = 0;
+    m_quit = false;
+
+    for (auto& e : m_slots) {
+        e.resize(m_slot_size);
+    }
+
+    mutexInit(&m_mutex);
+    condvarInit(&m_can_work);
+    condvarInit(&m_can_submit);
+
+    // lowest priority, the emulator must never wait on this thread.
+    R_TRY(threadCreate(&m_thread, ThreadFunc, this, nullptr, 1024*128, 0x3F, 2));
+    if (R_FAILED(threadStart(&m_thread))) {
+        threadClose(&m_thread);
+        R_THROW(0x1);
+    }
+
+    m_running = true;
+    R_SUCCEED();
+}
+
+void RewindWorker::Exit() {
+    if (!m_running) {
+        return;
+    }
+
+    mutexLock(&m_mutex);
+    m_quit = true;
+    condvarWakeAll(&m_can_work);
+    mutexUnlock(&m_mutex);
+
+    threadWaitForExit(&m_thread);
+    threadClose(&m_thread);
+
+    for (auto& e : m_slots) {
+        e = {};
+    }
+
+    m_auto_codecs = {};
+    m_auto_results = {};
+    m_auto_compress_buf = {};
+    m_auto_decompress_buf = {};
+    m_rewind = nullptr;
+    m_running = false;
+}
+
+auto RewindWorker::Acquire() -> void* {
+    if (!m_running) {
+        return nullptr;
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+
+    // only happens if the worker fell behind by SLOT_COUNT frames.
+    while (m_w_index - m_r_index >= SLOT_COUNT) {
+        log_write("[rewind] worker is behind, waiting for free slot\n");
+        condvarWait(&m_can_submit, &m_mutex);
+    }
+
+    return m_slots[m_w_index % SLOT_COUNT].data();
+}
+
+void RewindWorker::Submit() {
+    if (!m_running) {
+        return;
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    m_w_index++;
+    condvarWakeOne(&m_can_work);
+}
+
+void RewindWorker::Flush() {
+    if (!m_running) {
+        return;
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    while (m_r_index != m_w_index) {
+        condvarWait(&m_can_submit, &m_mutex);
+    }
+}
+
+void RewindWorker::GetStats(RewindStats* stats) {
+    if (!m_running) {
+        return;
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    rewind_get_stats(m_rewind, stats);
+}
+
+void RewindWorker::SetCodec(RewindCodec* codec) {
+    if (!m_running) {
+        return;
+    }
+
+    // the worker may be measuring codecs.
+    Flush();
+
+    SCOPED_MUTEX(&m_mutex);
+    m_auto_codecs = {};
+    rewind_set_compressor(m_rewind, rewind_codec_compressor, rewind_codec_compressor_size, codec);
+}
+
+void RewindWorker::SetAutoSelect(std::span<RewindCodec> codecs) {
+    if (!m_running || codecs.empty()) {
+        return;
+    }
+
+    Flush();
+
+    SCOPED_MUTEX(&m_mutex);
+    m_auto_codecs = codecs;
+    m_auto_results.assign(codecs.size(), {});
+    m_auto_samples = 0;
+
+    // use the first codec until measuring has finished.
+    rewind_set_compressor(m_rewind, rewind_codec_compressor, rewind_codec_compressor_size, &codecs[0]);
+}
+
+void RewindWorker::AutoSelectMeasure(const void* data) {
+    m_auto_compress_buf.resize(rewind_codec_compressor_size(nullptr, m_slot_size));
+    m_auto_decompress_buf.resize(m_slot_size);
+
+    for (size_t i = 0; i < m_auto_codecs.size(); i++) {
+        auto& codec = m_auto_codecs[i];
+        auto& result = m_auto_results[i];
+
+        TimeStamp ts;
+        const auto compressed = rewind_codec_compressor(&codec, data, m_auto_compress_buf.data(), m_slot_size, m_auto_compress_buf.size(), false);
+        result.push_ns += ts.GetNs();
+
+        ts.Update();
+        const auto decompressed = rewind_codec_compressor(&codec, m_auto_compress_buf.data(), m_auto_decompress_buf.data(), compressed, m_auto_decompress_buf.size(), true);
+        result.pop_ns += ts.GetNs();
+
+        if (!compressed || decompressed != m_slot_size) {
+            result.failed = true;
+        }
+
+        result.compressed += compressed;
+    }
+
+    m_auto_samples++;
+}
+
+void RewindWorker::AutoSelectFinish() {
+    s64 best = -1;
+
+    for (size_t i = 0; i < m_auto_codecs.size(); i++) {
+        const auto& r = m_auto_results[i];
+        const auto push_ns = r.push_ns / m_auto_samples;
+        const auto pop_ns = r.pop_ns / m_auto_samples;
+        const auto fits = !r.failed && push_ns <= AUTO_PUSH_BUDGET_NS && pop_ns <= AUTO_POP_BUDGET_NS;
+
+        log_write("[rewind] auto %s: ratio: %.2f%% push: %.2fms pop: %.2fms fits: %u\n",
+            rewind_codec_get_name(m_auto_codecs[i].type),
+            (double)r.compressed / (double)(m_slot_size * m_auto_samples) * 100.0,
+            (double)push_ns / 1e+6, (double)pop_ns / 1e+6, fits);
+
+        if (fits && (best < 0 || r.compressed < m_auto_results[best].compressed)) {
+            best = i;
+        }
+    }
+
+    // fallback to the first codec if nothing fits.
+    if (best < 0) {
+        best = 0;
+    }
+
+    log_write("[rewind] auto selected: %s\n", rewind_codec_get_name(m_auto_codecs[best].type));
+    rewind_set_compressor(m_rewind, rewind_codec_compressor, rewind_codec_compressor_size, &m_auto_codecs[best]);
+
+    m_auto_codecs = {};
+    m_auto_results = {};
+    m_auto_compress_buf = {};
+    m_auto_decompress_buf = {};
+}
+
+void RewindWorker::ThreadFunc(void* arg) {
+    static_cast<RewindWorker*>(arg)->ThreadLoop();
+}
+
+void RewindWorker::ThreadLoop() {
+    static_assert((SLOT_COUNT & (SLOT_COUNT - 1)) == 0, "Must be power of 2!");
+
+    for (;;) {
+        mutexLock(&m_mutex);
+        while (m_r_index == m_w_index && !m_quit) {
+            condvarWait(&m_can_work, &m_mutex);
+        }
+
+        // drain all pending slots before exiting.
+        if (m_r_index == m_w_index) {
+            mutexUnlock(&m_mutex);
+            break;
+        }
+
+        const auto& slot = m_slots[m_r_index % SLOT_COUNT];
+        const auto auto_select = !m_auto_codecs.empty();
+        mutexUnlock(&m_mutex);
+
+        // the slot is owned by this thread until m_r_index is incremented.
+        TimeStamp ts;
+        size_t compressed;
+        auto data = rewind_compress(m_rewind, slot.data(), m_slot_size, &compressed);
+        const auto compress_ns = ts.GetNs();
+
+        // measured outside of the push time so that auto select does not
+        // inflate the recorded latency.
+        if (auto_select) {
+            AutoSelectMeasure(slot.data());
+        }
+
+        mutexLock(&m_mutex);
+        if (auto_select && !m_auto_codecs.empty() && m_auto_samples >= AUTO_SAMPLE_COUNT) {
+            AutoSelectFinish();
+        }
+
+        ts.Update();
+        if (!data) {
+            log_write("[rewind] failed to compress frame\n");
+        } else if (!rewind_push_compressed(m_rewind, data, compressed, m_slot_size)) {
+            log_write("[rewind] failed to push frame\n");
+        } else {
+            rewind_add_push_time(m_rewind, compress_ns + ts.GetNs());
+        }
+
+        m_r_index++;
+        condvarWakeAll(&m_can_submit);
+        mutexUnlock(&m_mutex);
+    }
+}
+
+} // namespace sphaira
@@ -0,0 +1,144 @@
+#include "emu_helpers/savestate_index.hpp"
+#include "emu_helpers/savestate_writer.hpp"
+#include "defines.hpp"
+#include "log.hpp"
+#include <cstring>
+#include <cstdio>
+
+namespace sphaira {
+namespace {
+
+constexpr u32 INDEX_MAGIC = 0x58444953; // SIDX
+constexpr u32 INDEX_VERSION = 0;
+
+struct IndexHeader {
+    u32 magic;
+    u32 version;
+    u32 slot_count;
+    u32 reserved;
+};
+
+struct IndexSlot {
+    u64 timestamp;
+    u16 thumbnail_w;
+    u16 thumbnail_h;
+    u8 used;
+    u8 reserved[3];
+    // followed by thumbnail_w * thumbnail_h * 4 bytes.
+};
+
+} // namespace
+
+auto SaveStateIndex::GetRomName(const fs::FsPath& rom_path) -> fs::FsPath {
+    const char* name = std::strrchr(rom_path, '/');
+    char hash[32];
+    std::snprintf(hash, sizeof(hash), ".%016lX", fs::HashPath(rom_path));
+    return fs::FsPath{name ? name + 1 : rom_path.s} + hash;
+}
+
+auto SaveStateIndex::GetIndexPath(const fs::FsPath& rom_path) -> fs::FsPath {
+    return fs::FsPath{PATH} + GetRomName(rom_path) + ".idx";
+}
+
+auto SaveStateIndex::GetLegacyIndexPath(const fs::FsPath& rom_path) -> fs::FsPath {
+    const char* name = std::strrchr(rom_path, '/');
+    return fs::FsPath{PATH} + (name ? name + 1 : rom_path.s) + ".idx";
+}
+
+Result SaveStateIndex::Load(const fs::FsPath& path) {
+    m_path = path;
+    for (auto& e : m_slots) {
+        e = {};
+    }
+
+    std::vector<u8> data;
+    R_TRY(SaveStateWriter::ReadFile(m_path, data));
+
+    IndexHeader header;
+    R_UNLESS(data.size() >= sizeof(header), 0x1);
+    std::memcpy(&header, data.data(), sizeof(header));
+    R_UNLESS(header.magic == INDEX_MAGIC && header.version == INDEX_VERSION, 0x1);
+
+    size_t off = sizeof(header);
+    for (u32 i = 0; i < header.slot_count && i < SLOT_COUNT; i++) {
+        IndexSlot slot;
+        R_UNLESS(off + sizeof(slot) <= data.size(), 0x1);
+        std::memcpy(&slot, data.data() + off, sizeof(slot));
+        off += sizeof(slot);
+
+        const size_t thumbnail_size = slot.thumbnail_w * slot.thumbnail_h * sizeof(u32);
+        R_UNLESS(off + thumbnail_size <= data.size(), 0x1);
+
+        auto& e = m_slots[i];
+        e.used = slot.used;
+        e.timestamp = slot.timestamp;
+        e.thumbnail_w = slot.thumbnail_w;
+        e.thumbnail_h = slot.thumbnail_h;
+        e.thumbnail.assign(data.data() + off, data.data() + off + thumbnail_size);
+        off += thumbnail_size;
+    }
+
+    R_SUCCEED();
+}
+
+Result SaveStateIndex::Save() const {
+    fs::FsNativeSd fs;
+    fs.CreateDirectoryRecursivelyWithPath(m_path);
+    return fs::write_entire_file(m_path, Serialize());
+}
+
+auto SaveStateIndex::Serialize() const -> std::vector<u8> {
+    std::vector<u8> data(sizeof(IndexHeader));
+
+    const IndexHeader header{INDEX_MAGIC, INDEX_VERSION, SLOT_COUNT, 0};
+    std::memcpy(data.data(), &header, sizeof(header));
+
+    for (const auto& e : m_slots) {
+        const IndexSlot slot{e.timestamp, e.thumbnail_w, e.thumbnail_h, e.used, {}};
+        const auto ptr = (const u8*)&slot;
+        data.insert(data.end(), ptr, ptr + sizeof(slot));
+        data.insert(data.end(), e.thumbnail.begin(), e.thumbnail.end());
+    }
+
+    return data;
+}
+
+void SaveStateIndex::Set(u32 slot, u64 timestamp, const u32* pixels, u32 w, u32 h, u32 stride) {
+    auto& e = m_slots[slot];
+    e.used = true;
+    e.timestamp = timestamp;
+    e.thumbnail_w = w / THUMBNAIL_SCALE;
+    e.thumbnail_h = h / THUMBNAIL_SCALE;
+    e.thumbnail.resize(e.thumbnail_w * e.thumbnail_h * sizeof(u32));
+
+    // point sample, the thumbnails are only shown small.
+    auto out = (u32*)e.thumbnail.data();
+    for (u32 y = 0; y < e.thumbnail_h; y++) {
+        const auto in = pixels + y * THUMBNAIL_SCALE * stride;
+        for (u32 x = 0; x < e.thumbnail_w; x++) {
+            *out++ = in[x * THUMBNAIL_SCALE] | 0xFF000000;
+        }
+    }
+}
+
+void SaveStateIndex::Clear(u32 slot) {
+    m_slots[slot] = {};
+}
+
+auto SaveStateIndex::GetNextAutoSlot() const -> u32 {
+    u32 next = USER_SLOT_COUNT;
+
+    for (u32 i = USER_SLOT_COUNT; i < SLOT_COUNT; i++) {
+        if (!m_slots[i].used) {
+            return i;
+        }
+
+        if (m_slots[i].timestamp < m_slots[next].timestamp) {
+            next = i;
+        }
+    }
+
+    return next;
+}
+
+} // namespace sphaira
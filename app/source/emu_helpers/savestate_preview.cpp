@@ -0,0 +1,235 @@
+#include "emu_helpers/savestate_preview.hpp"
+#include "emu_helpers/savestate_index.hpp"
+#include "defines.hpp"
+#include "image.hpp"
+#include "log.hpp"
+#include <mgb.h>
+#include <cstring>
+#include <utility>
+
+namespace sphaira {
+namespace {
+
+// scrolling quickly queues a request per row, only the newest ones matter.
+constexpr size_t MAX_QUEUED = 16;
+
+// mgb stores its savestate next to the rom with the extension replaced.
+auto GetLegacyPath(const fs::FsPath& rom_path) -> fs::FsPath {
+    auto path = rom_path;
+    if (auto ext = std::strrchr(path.s, '.'); ext && !std::strchr(ext, '/')) {
+        *ext = '\0';
+    }
+    return path + ".state";
+}
+
+auto GetMtime(fs::Fs* fs, const fs::FsPath& path) -> u64 {
+    FsTimeStampRaw ts{};
+    if (R_FAILED(fs->GetFileTimeStampRaw(path, &ts)) || !ts.is_valid) {
+        return 0;
+    }
+    return ts.modified;
+}
+
+auto LoadFromIndex(const fs::FsPath& rom_path) -> std::shared_ptr<SaveStatePreview> {
+    SaveStateIndex index;
+    if (R_FAILED(index.Load(SaveStateIndex::GetIndexPath(rom_path)))) {
+        return {};
+    }
+
+    const SaveStateSlot* newest{};
+    for (u32 i = 0; i < SaveStateIndex::SLOT_COUNT; i++) {
+        const auto& slot = index.Get(i);
+        if (slot.used && !slot.thumbnail.empty() && (!newest || slot.timestamp > newest->timestamp)) {
+            newest = &slot;
+        }
+    }
+
+    if (!newest) {
+        return {};
+    }
+
+    auto preview = std::make_shared<SaveStatePreview>();
+    preview->timestamp = newest->timestamp;
+    preview->w = newest->thumbnail_w;
+    preview->h = newest->thumbnail_h;
+    preview->thumbnail = newest->thumbnail;
+    return preview;
+}
+
+// savestates made before the index existed, this decodes the png.
+auto LoadFromLegacy(const fs::FsPath& path) -> std::shared_ptr<SaveStatePreview> {
+    auto info = mgb_load_state_info_file(path, true);
+    if (!info) {
+        return {};
+    }
+    ON_SCOPE_EXIT(mgb_free_state_info(info));
+
+    auto image = ImageLoadFromMemory({info->png, info->png_size});
+    if (image.data.empty()) {
+        return {};
+    }
+
+    auto preview = std::make_shared<SaveStatePreview>();
+    preview->timestamp = info->meta.timestamp;
+    preview->w = image.w;
+    preview->h = image.h;
+    preview->thumbnail = std::move(image.data);
+    return preview;
+}
+
+} // namespace
+
+SaveStatePreviewCache::~SaveStatePreviewCache() {
+    Exit();
+}
+
+Result SaveStatePreviewCache::Init() {
+    Exit();
+
+    m_entries.clear();
+    m_queue.clear();
+    m_quit = false;
+
+    mutexInit(&m_mutex);
+    condvarInit(&m_can_work);
+
+    R_TRY(threadCreate(&m_thread, ThreadFunc, this, nullptr, 1024*64, 0x3F, 2));
+    if (R_FAILED(threadStart(&m_thread))) {
+        threadClose(&m_thread);
+        R_THROW(0x1);
+    }
+
+    m_running = true;
+    R_SUCCEED();
+}
+
+void SaveStatePreviewCache::Exit() {
+    if (!m_running) {
+        return;
+    }
+
+    mutexLock(&m_mutex);
+    m_quit = true;
+    condvarWakeAll(&m_can_work);
+    mutexUnlock(&m_mutex);
+
+    threadWaitForExit(&m_thread);
+    threadClose(&m_thread);
+
+    m_entries.clear();
+    m_queue.clear();
+    m_running = false;
+}
+
+void SaveStatePreviewCache::Clear() {
+    if (!m_running) {
+        return;
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    m_entries.clear();
+    m_queue.clear();
+}
+
+void SaveStatePreviewCache::Invalidate() {
+    if (!m_running) {
+        return;
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    for (auto& [_, e] : m_entries) {
+        e.stale = true;
+    }
+}
+
+auto SaveStatePreviewCache::Get(const fs::FsPath& rom_path) -> std::shared_ptr<const SaveStatePreview> {
+    if (!m_running) {
+        return {};
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    auto [it, inserted] = m_entries.try_emplace(rom_path.toString());
+    auto& e = it->second;
+
+    if (inserted || e.stale) {
+        e.stale = false;
+        m_queue.emplace_back(it->first);
+        if (m_queue.size() > MAX_QUEUED) {
+            // dropped entries are loaded again if they are requested.
+            if (auto old = m_entries.find(m_queue.front()); old != m_entries.end() && !old->second.loaded) {
+                m_entries.erase(old);
+            }
+            m_queue.pop_front();
+        }
+        condvarWakeOne(&m_can_work);
+    }
+
+    return e.preview;
+}
+
+void SaveStatePreviewCache::ThreadFunc(void* arg) {
+    static_cast<SaveStatePreviewCache*>(arg)->ThreadLoop();
+}
+
+void SaveStatePreviewCache::ThreadLoop() {
+    for (;;) {
+        std::string rom_path;
+        {
+            SCOPED_MUTEX(&m_mutex);
+            while (m_queue.empty() && !m_quit) {
+                condvarWait(&m_can_work, &m_mutex);
+            }
+
+            if (m_quit) {
+                break;
+            }
+
+            // newest first, this is the row the user is looking at.
+            rom_path = std::move(m_queue.back());
+            m_queue.pop_back();
+        }
+
+        Load(rom_path);
+    }
+}
+
+void SaveStatePreviewCache::Load(const std::string& rom_path) {
+    const fs::FsPath path{rom_path};
+    const auto legacy_path = GetLegacyPath(path);
+    const auto index_mtime = GetMtime(&m_fs, SaveStateIndex::GetIndexPath(path));
+    const auto legacy_mtime = GetMtime(&m_fs, legacy_path);
+
+    {
+        SCOPED_MUTEX(&m_mutex);
+        const auto it = m_entries.find(rom_path);
+        if (it == m_entries.end()) {
+            return;
+        }
+
+        const auto& e = it->second;
+        if (e.loaded && e.index_mtime == index_mtime && e.legacy_mtime == legacy_mtime) {
+            return;
+        }
+    }
+
+    std::shared_ptr<SaveStatePreview> preview;
+    if (index_mtime) {
+        preview = LoadFromIndex(path);
+    }
+    if (!preview && legacy_mtime) {
+        preview = LoadFromLegacy(legacy_path);
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    // the directory may have changed whilst loading.
+    const auto it = m_entries.find(rom_path);
+    if (it != m_entries.end()) {
+        auto& e = it->second;
+        e.index_mtime = index_mtime;
+        e.legacy_mtime = legacy_mtime;
+        e.loaded = true;
+        e.preview = std::move(preview);
+    }
+}
+
+} // namespace sphaira
@@ -0,0 +1,224 @@
+#include "emu_helpers/savestate_writer.hpp"
+#include "emu_helpers/qoi_encode.h"
+#include "ui/types.hpp"
+#include "defines.hpp"
+#include "log.hpp"
+#include <cstring>
+#include <cstdlib>
+#include <utility>
+#include <span>
+
+namespace sphaira {
+namespace {
+
+// the old file is renamed to .bak before the temp file replaces it, as the
+// file must not exist to be renamed over. if the main file is missing and
+// the .bak exists then the .tmp was fully written, see ReadFile().
+void Recover(fs::Fs* fs, const fs::FsPath& path, const fs::FsPath& temp_path, const fs::FsPath& bak_path) {
+    if (fs->FileExists(path) || !fs->FileExists(bak_path)) {
+        return;
+    }
+
+    if (R_FAILED(fs->RenameFile(temp_path, path))) {
+        fs->RenameFile(bak_path, path);
+    }
+}
+
+Result WriteAtomic(fs::Fs* fs, const fs::FsPath& path, std::span<const u8> a, std::span<const u8> b = {}) {
+    const auto temp_path = path + ".tmp";
+    const auto bak_path = path + ".bak";
+
+    // a new temp file must not be created whilst the old one is needed.
+    Recover(fs, path, temp_path, bak_path);
+
+    fs->DeleteFile(temp_path);
+    R_TRY(fs->CreateFile(temp_path, a.size() + b.size()));
+
+    {
+        fs::File f;
+        R_TRY(fs->OpenFile(temp_path, FsOpenMode_Write, &f));
+        R_TRY(f.Write(0, a.data(), a.size(), b.empty() ? FsWriteOption_Flush : FsWriteOption_None));
+        if (!b.empty()) {
+            R_TRY(f.Write(a.size(), b.data(), b.size(), FsWriteOption_Flush));
+        }
+    }
+
+    // rename fails if the file exists.
+    if (fs->FileExists(path)) {
+        fs->DeleteFile(bak_path);
+        R_TRY(fs->RenameFile(path, bak_path));
+    }
+    R_TRY(fs->RenameFile(temp_path, path));
+    fs->DeleteFile(bak_path);
+    R_SUCCEED();
+}
+
+} // namespace
+
+SaveStateWriter::~SaveStateWriter() {
+    Exit();
+}
+
+Result SaveStateWriter::Init() {
+    Exit();
+
+    m_jobs.clear();
+    m_busy = false;
+    m_failed = 0;
+    m_quit = false;
+
+    mutexInit(&m_mutex);
+    condvarInit(&m_can_work);
+    condvarInit(&m_done);
+
+    R_TRY(threadCreate(&m_thread, ThreadFunc, this, nullptr, 1024*64, 0x3F, 2));
+    if (R_FAILED(threadStart(&m_thread))) {
+        threadClose(&m_thread);
+        R_THROW(0x1);
+    }
+
+    m_running = true;
+    R_SUCCEED();
+}
+
+void SaveStateWriter::Exit() {
+    if (!m_running) {
+        return;
+    }
+
+    mutexLock(&m_mutex);
+    m_quit = true;
+    condvarWakeAll(&m_can_work);
+    mutexUnlock(&m_mutex);
+
+    threadWaitForExit(&m_thread);
+    threadClose(&m_thread);
+
+    m_jobs.clear();
+    m_running = false;
+}
+
+void SaveStateWriter::Push(SaveStateJob&& job) {
+    if (!m_running) {
+        if (R_FAILED(Write(job))) {
+            m_failed++;
+        }
+        return;
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    m_jobs.emplace_back(std::move(job));
+    condvarWakeOne(&m_can_work);
+}
+
+void SaveStateWriter::Flush() {
+    if (!m_running) {
+        return;
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    while (!m_jobs.empty() || m_busy) {
+        condvarWait(&m_done, &m_mutex);
+    }
+}
+
+auto SaveStateWriter::PopFailedCount() -> u32 {
+    if (!m_running) {
+        return std::exchange(m_failed, 0);
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    return std::exchange(m_failed, 0);
+}
+
+Result SaveStateWriter::ReadFile(const fs::FsPath& path, std::vector<u8>& out) {
+    fs::FsNativeSd fs;
+    if (R_SUCCEEDED(fs.read_entire_file(path, out))) {
+        R_SUCCEED();
+    }
+
+    // power was lost whilst the file was replaced, see Recover().
+    const auto bak_path = path + ".bak";
+    R_UNLESS(fs.FileExists(bak_path), 0x1);
+    if (R_SUCCEEDED(fs.read_entire_file(path + ".tmp", out))) {
+        R_SUCCEED();
+    }
+    return fs.read_entire_file(bak_path, out);
+}
+
+Result SaveStateWriter::WriteFile(const fs::FsPath& path, std::span<const u8> data) {
+    fs::FsNativeSd fs;
+    R_TRY(fs.GetFsOpenResult());
+    return WriteAtomic(&fs, path, data);
+}
+
+Result SaveStateWriter::Write(const SaveStateJob& job) {
+    fs::FsNativeSd fs;
+    R_TRY(fs.GetFsOpenResult());
+
+    if (!job.path.empty()) {
+        R_TRY(WriteSaveState(&fs, job));
+    }
+
+    if (!job.extra_path.empty()) {
+        R_TRY(WriteAtomic(&fs, job.extra_path, job.extra));
+    }
+
+    R_SUCCEED();
+}
+
+Result SaveStateWriter::WriteSaveState(fs::Fs* fs, const SaveStateJob& job) {
+    fs->CreateDirectoryRecursivelyWithPath(job.path);
+
+    size_t thumbnail_size{};
+    auto thumbnail = qoi_encode_rgbx(job.pixels.data(), job.w, job.h, job.w, &thumbnail_size);
+    ON_SCOPE_EXIT(std::free(thumbnail));
+    if (!thumbnail) {
+        thumbnail_size = 0;
+    }
+
+    std::vector<u8> data(sizeof(SaveStateHeader) + job.state.size());
+    const SaveStateHeader header{SaveStateHeader::MAGIC, SaveStateHeader::VERSION, job.timestamp, (u32)job.state.size(), (u32)thumbnail_size};
+    std::memcpy(data.data(), &header, sizeof(header));
+    std::memcpy(data.data() + sizeof(header), job.state.data(), job.state.size());
+
+    return WriteAtomic(fs, job.path, data, {(const u8*)thumbnail, thumbnail_size});
+}
+
+void SaveStateWriter::ThreadFunc(void* arg) {
+    static_cast<SaveStateWriter*>(arg)->ThreadLoop();
+}
+
+void SaveStateWriter::ThreadLoop() {
+    for (;;) {
+        mutexLock(&m_mutex);
+        while (m_jobs.empty() && !m_quit) {
+            condvarWait(&m_can_work, &m_mutex);
+        }
+
+        // write all pending savestates before exiting.
+        if (m_jobs.empty()) {
+            mutexUnlock(&m_mutex);
+            break;
+        }
+
+        auto job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        m_busy = true;
+        mutexUnlock(&m_mutex);
+
+        TimeStamp ts;
+        const auto rc = Write(job);
+        log_write("[savestate] wrote: %s rc: 0x%X time: %zums\n", job.path.s, rc, ts.GetMs());
+
+        mutexLock(&m_mutex);
+        if (R_FAILED(rc)) {
+            m_failed++;
+        }
+        m_busy = false;
+        condvarWakeAll(&m_done);
+        mutexUnlock(&m_mutex);
+    }
+}
+
+} // namespace sphaira
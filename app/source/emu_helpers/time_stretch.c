@@ -0,0 +1,255 @@
+#include "emu_helpers/time_stretch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+enum { CHANNELS = 2 };
+
+/* the search first checks every COARSE_STEP offset, then every offset around the best match. */
+enum { COARSE_STEP = 4 };
+
+struct TimeStretch
+{
+    double ratio;
+    /* all in frames. */
+    size_t sequence;
+    size_t overlap;
+    size_t seek;
+
+    int16_t* in;
+    size_t in_count;
+    size_t in_cap;
+    /* nominal start of the next segment, advances by ratio per output frame. */
+    double in_pos;
+
+    /* end of the previous segment, cross-faded into the next segment. */
+    int16_t* tail;
+    float* tail_mono;
+    int has_tail;
+
+    /* mono copy of the seek window, so the correlation is a plain dot product. */
+    float* mono;
+
+    int16_t* out;
+    size_t out_count;
+    size_t out_pos;
+};
+
+static size_t ms_to_frames(unsigned sample_rate, unsigned ms)
+{
+    return (size_t)sample_rate * ms / 1000;
+}
+
+TimeStretch* time_stretch_init(unsigned sample_rate, size_t max_input)
+{
+    TimeStretch* ts = calloc(1, sizeof(*ts));
+    if (!ts)
+    {
+        return NULL;
+    }
+
+    ts->ratio = 1.0;
+    ts->sequence = ms_to_frames(sample_rate, 40);
+    ts->overlap = ms_to_frames(sample_rate, 8);
+    ts->seek = ms_to_frames(sample_rate, 15);
+
+    ts->in_cap = max_input + ts->sequence + ts->seek;
+    ts->in = malloc(ts->in_cap * CHANNELS * sizeof(*ts->in));
+    ts->tail = malloc(ts->overlap * CHANNELS * sizeof(*ts->tail));
+    ts->tail_mono = malloc(ts->overlap * sizeof(*ts->tail_mono));
+    ts->mono = malloc((ts->seek + ts->overlap) * sizeof(*ts->mono));
+    ts->out = malloc(ts->sequence * CHANNELS * sizeof(*ts->out));
+
+    if (!ts->in || !ts->tail || !ts->tail_mono || !ts->mono || !ts->out)
+    {
+        time_stretch_quit(ts);
+        return NULL;
+    }
+
+    return ts;
+}
+
+void time_stretch_quit(TimeStretch* ts)
+{
+    if (!ts)
+    {
+        return;
+    }
+
+    free(ts->in);
+    free(ts->tail);
+    free(ts->tail_mono);
+    free(ts->mono);
+    free(ts->out);
+    free(ts);
+}
+
+void time_stretch_set_ratio(TimeStretch* ts, double ratio)
+{
+    ts->ratio = ratio;
+}
+
+void time_stretch_reset(TimeStretch* ts)
+{
+    ts->in_count = 0;
+    ts->in_pos = 0;
+    ts->has_tail = 0;
+    ts->out_count = 0;
+    ts->out_pos = 0;
+}
+
+size_t time_stretch_push(TimeStretch* ts, const int16_t* samples, size_t frames)
+{
+    size_t skipped = 0;
+
+    /* at high ratios the next segment can start past the end of the buffered input. */
+    if (!ts->in_count && ts->in_pos >= 1.0)
+    {
+        skipped = (size_t)ts->in_pos < frames ? (size_t)ts->in_pos : frames;
+        samples += skipped * CHANNELS;
+        frames -= skipped;
+        ts->in_pos -= skipped;
+    }
+
+    if (frames > ts->in_cap - ts->in_count)
+    {
+        frames = ts->in_cap - ts->in_count;
+    }
+
+    memcpy(ts->in + ts->in_count * CHANNELS, samples, frames * CHANNELS * sizeof(*samples));
+    ts->in_count += frames;
+    return skipped + frames;
+}
+
+static float correlate(const float* a, const float* b, size_t count)
+{
+    /* kept branchless over contiguous floats so that it vectorises. */
+    float sum = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static float score(const TimeStretch* ts, size_t offset)
+{
+    const float* candidate = ts->mono + offset;
+    const float energy = correlate(candidate, candidate, ts->overlap);
+    return correlate(ts->tail_mono, candidate, ts->overlap) / sqrtf(energy + 1.0f);
+}
+
+/* returns the offset within the seek window that best continues the previous segment. */
+static size_t find_best_offset(TimeStretch* ts, size_t start)
+{
+    const int16_t* in = ts->in + start * CHANNELS;
+    for (size_t i = 0; i < ts->seek + ts->overlap; i++)
+    {
+        ts->mono[i] = (float)in[i * CHANNELS + 0] + (float)in[i * CHANNELS + 1];
+    }
+
+    size_t best = 0;
+    float best_score = -INFINITY;
+
+    for (size_t i = 0; i < ts->seek; i += COARSE_STEP)
+    {
+        const float s = score(ts, i);
+        if (s > best_score)
+        {
+            best = i;
+            best_score = s;
+        }
+    }
+
+    const size_t lo = best >= COARSE_STEP ? best - COARSE_STEP + 1 : 0;
+    const size_t hi = best + COARSE_STEP < ts->seek ? best + COARSE_STEP : ts->seek;
+    for (size_t i = lo; i < hi; i++)
+    {
+        const float s = score(ts, i);
+        if (s > best_score)
+        {
+            best = i;
+            best_score = s;
+        }
+    }
+
+    return best;
+}
+
+/* returns 0 if there is not enough input for a segment. */
+static int process_segment(TimeStretch* ts)
+{
+    const size_t start = (size_t)ts->in_pos;
+    if (ts->in_count < start + ts->seek + ts->sequence)
+    {
+        return 0;
+    }
+
+    const size_t offset = ts->has_tail ? find_best_offset(ts, start) : 0;
+    const int16_t* segment = ts->in + (start + offset) * CHANNELS;
+    const size_t output = ts->sequence - ts->overlap;
+
+    if (ts->has_tail)
+    {
+        for (size_t i = 0; i < ts->overlap; i++)
+        {
+            const float t = (float)i / (float)ts->overlap;
+            for (size_t c = 0; c < CHANNELS; c++)
+            {
+                const size_t j = i * CHANNELS + c;
+                ts->out[j] = (int16_t)(ts->tail[j] * (1.0f - t) + segment[j] * t);
+            }
+        }
+        memcpy(ts->out + ts->overlap * CHANNELS, segment + ts->overlap * CHANNELS, (output - ts->overlap) * CHANNELS * sizeof(*ts->out));
+    }
+    else
+    {
+        memcpy(ts->out, segment, output * CHANNELS * sizeof(*ts->out));
+    }
+
+    /* the end of this segment is faded into the next one. */
+    const int16_t* tail = segment + output * CHANNELS;
+    memcpy(ts->tail, tail, ts->overlap * CHANNELS * sizeof(*ts->tail));
+    for (size_t i = 0; i < ts->overlap; i++)
+    {
+        ts->tail_mono[i] = (float)tail[i * CHANNELS + 0] + (float)tail[i * CHANNELS + 1];
+    }
+    ts->has_tail = 1;
+
+    ts->out_count = output;
+    ts->out_pos = 0;
+
+    /* drop input that can no longer be used. */
+    ts->in_pos += output * ts->ratio;
+    const size_t consumed = (size_t)ts->in_pos < ts->in_count ? (size_t)ts->in_pos : ts->in_count;
+    memmove(ts->in, ts->in + consumed * CHANNELS, (ts->in_count - consumed) * CHANNELS * sizeof(*ts->in));
+    ts->in_count -= consumed;
+    ts->in_pos -= consumed;
+
+    return 1;
+}
+
+size_t time_stretch_pull(TimeStretch* ts, int16_t* samples, size_t max_frames)
+{
+    size_t written = 0;
+
+    while (written < max_frames)
+    {
+        if (ts->out_pos == ts->out_count && !process_segment(ts))
+        {
+            break;
+        }
+
+        size_t count = ts->out_count - ts->out_pos;
+        if (count > max_frames - written)
+        {
+            count = max_frames - written;
+        }
+
+        memcpy(samples + written * CHANNELS, ts->out + ts->out_pos * CHANNELS, count * CHANNELS * sizeof(*samples));
+        ts->out_pos += count;
+        written += count;
+    }
+
+    return written;
+}
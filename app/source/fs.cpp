@@ -109,6 +109,15 @@ FsPath AppendPath(const FsPath& root_path, const FsPath& _file_path) {
     return path;
 }
 
+u64 HashPath(const char* path) {
+    u64 hash = 0xCBF29CE484222325;
+    for (; *path; path++) {
+        hash ^= (u8)*path;
+        hash *= 0x100000001B3;
+    }
+    return hash;
+}
+
 Result CreateFile(FsFileSystem* fs, const FsPath& path, u64 size, u32 option, bool ignore_read_only) {
     R_UNLESS(ignore_read_only || !is_read_only_root(path), Result_FsReadOnly);
 
@@ -367,6 +367,11 @@ void FileFuncNative(zlib_filefunc64_def* funcs) {
 }
 
 Result PeekFirstFileName(fs::Fs* fs, const fs::FsPath& path, fs::FsPath& name) {
+    u32 crc32;
+    return PeekFirstFile(fs, path, name, crc32);
+}
+
+Result PeekFirstFile(fs::Fs* fs, const fs::FsPath& path, fs::FsPath& name, u32& crc32) {
     fs::File file;
     R_TRY(fs->OpenFile(path, FsOpenMode_Read, &file));
 
@@ -381,6 +386,8 @@ Result PeekFirstFileName(fs::Fs* fs, const fs::FsPath& path, fs::FsPath& name) {
     R_TRY(file.Read(bytes_read, name, name_len, 0, &bytes_read));
     name[name_len] = '\0';
 
+    // bit 3 means the crc and sizes are in a data descriptor after the data.
+    crc32 = (local_hdr.flags & (1 << 3)) ? 0 : local_hdr.crc32;
     R_SUCCEED();
 }
 
@@ -0,0 +1,390 @@
+#include "rom_library.hpp"
+#include "minizip_helper.hpp"
+#include "emu_helpers/savestate_writer.hpp"
+#include "defines.hpp"
+#include "log.hpp"
+#include "ui/types.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <span>
+#include <unordered_map>
+
+namespace sphaira {
+namespace {
+
+constexpr u32 LIBRARY_MAGIC = 0x42494C54; // TLIB
+constexpr u32 LIBRARY_VERSION = 0;
+
+// roms are at most a few MiB, this is read in a few chunks.
+constexpr size_t READ_BUF_SIZE = 1024 * 256;
+
+struct LibraryHeader {
+    u32 magic;
+    u32 version;
+    u32 count;
+    u32 reserved;
+};
+
+struct LibraryEntry {
+    s64 size;
+    u64 mtime;
+    u32 crc32;
+    u8 system;
+    u8 reserved;
+    u16 path_len;
+    u16 internal_len;
+    u16 reserved2;
+    // followed by the path and the internal name.
+};
+
+auto GetExtension(std::string_view name) -> std::string_view {
+    const auto dot = name.find_last_of('.');
+    if (dot == name.npos) {
+        return {};
+    }
+    return name.substr(dot + 1);
+}
+
+auto IsExtension(std::string_view ext1, std::string_view ext2) -> bool {
+    return ext1.length() == ext2.length() && !strncasecmp(ext1.data(), ext2.data(), ext1.length());
+}
+
+auto IsRomExtension(std::string_view ext) -> bool {
+    return IsExtension(ext, "sms") || IsExtension(ext, "gg") || IsExtension(ext, "sg") || IsExtension(ext, "bin");
+}
+
+// bin is used for every system, its header is checked if the rom is read.
+auto GetSystemFromExtension(std::string_view ext) -> RomSystem {
+    if (IsExtension(ext, "sms")) {
+        return RomSystem_SMS;
+    } else if (IsExtension(ext, "gg")) {
+        return RomSystem_GG;
+    } else if (IsExtension(ext, "sg")) {
+        return RomSystem_SG;
+    }
+    return RomSystem_Unknown;
+}
+
+// the region code of the "TMR SEGA" header tells sms and gg roms apart.
+// sg-1000 roms have no header.
+auto GetSystemFromHeader(std::span<const u8> data) -> RomSystem {
+    for (const size_t off : {0x7FF0, 0x3FF0, 0x1FF0}) {
+        if (off + 16 > data.size() || std::memcmp(data.data() + off, "TMR SEGA", 8)) {
+            continue;
+        }
+
+        switch (data[off + 15] >> 4) {
+            case 3: case 4: return RomSystem_SMS;
+            case 5: case 6: case 7: return RomSystem_GG;
+        }
+        return RomSystem_Unknown;
+    }
+
+    return RomSystem_Unknown;
+}
+
+} // namespace
+
+RomLibrary::~RomLibrary() {
+    Exit();
+}
+
+Result RomLibrary::Init() {
+    Exit();
+
+    m_entries = std::make_shared<const RomLibraryEntries>();
+    m_roots.clear();
+    m_pending = false;
+    m_scanning = false;
+    m_quit = false;
+
+    mutexInit(&m_mutex);
+    condvarInit(&m_can_work);
+
+    R_TRY(threadCreate(&m_thread, ThreadFunc, this, nullptr, 1024*64, 0x3F, 2));
+    if (R_FAILED(threadStart(&m_thread))) {
+        threadClose(&m_thread);
+        R_THROW(0x1);
+    }
+
+    m_running = true;
+    R_SUCCEED();
+}
+
+void RomLibrary::Exit() {
+    if (!m_running) {
+        return;
+    }
+
+    mutexLock(&m_mutex);
+    m_quit = true;
+    condvarWakeAll(&m_can_work);
+    mutexUnlock(&m_mutex);
+
+    threadWaitForExit(&m_thread);
+    threadClose(&m_thread);
+
+    m_read_buf = {};
+    m_running = false;
+}
+
+void RomLibrary::Rescan(const std::vector<fs::FsPath>& roots) {
+    if (!m_running) {
+        return;
+    }
+
+    SCOPED_MUTEX(&m_mutex);
+    m_roots = roots;
+    m_pending = true;
+    condvarWakeOne(&m_can_work);
+}
+
+auto RomLibrary::GetEntries() const -> std::shared_ptr<const RomLibraryEntries> {
+    SCOPED_MUTEX(&m_mutex);
+    return m_entries;
+}
+
+auto RomLibrary::GetGeneration() const -> u64 {
+    SCOPED_MUTEX(&m_mutex);
+    return m_generation;
+}
+
+auto RomLibrary::IsScanning() const -> bool {
+    SCOPED_MUTEX(&m_mutex);
+    return m_pending || m_scanning;
+}
+
+void RomLibrary::ThreadFunc(void* arg) {
+    static_cast<RomLibrary*>(arg)->ThreadLoop();
+}
+
+void RomLibrary::ThreadLoop() {
+    Load();
+
+    for (;;) {
+        std::vector<fs::FsPath> roots;
+        {
+            SCOPED_MUTEX(&m_mutex);
+            while (!m_pending && !m_quit) {
+                condvarWait(&m_can_work, &m_mutex);
+            }
+
+            if (m_quit) {
+                break;
+            }
+
+            roots = m_roots;
+            m_pending = false;
+            m_scanning = true;
+        }
+
+        RomLibraryEntries entries;
+        const auto finished = Scan(roots, entries);
+
+        SCOPED_MUTEX(&m_mutex);
+        m_scanning = false;
+        if (finished) {
+            m_entries = std::make_shared<const RomLibraryEntries>(std::move(entries));
+            m_generation++;
+        }
+    }
+}
+
+bool RomLibrary::ShouldStop() {
+    SCOPED_MUTEX(&m_mutex);
+    return m_quit || m_pending;
+}
+
+void RomLibrary::Load() {
+    std::vector<u8> data;
+    if (R_FAILED(SaveStateWriter::ReadFile(PATH, data))) {
+        return;
+    }
+
+    LibraryHeader header;
+    if (data.size() < sizeof(header)) {
+        return;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != LIBRARY_MAGIC || header.version != LIBRARY_VERSION) {
+        return;
+    }
+
+    // stops a corrupt count from allocating more entries than the file could hold.
+    size_t off = sizeof(header);
+    if (header.count > (data.size() - off) / sizeof(LibraryEntry)) {
+        return;
+    }
+
+    RomLibraryEntries entries(header.count);
+    for (auto& e : entries) {
+        LibraryEntry entry;
+        if (off + sizeof(entry) > data.size()) {
+            return;
+        }
+        std::memcpy(&entry, data.data() + off, sizeof(entry));
+        off += sizeof(entry);
+
+        if (off + entry.path_len + entry.internal_len > data.size()) {
+            return;
+        }
+
+        e.path.assign((const char*)data.data() + off, entry.path_len);
+        off += entry.path_len;
+        e.internal_name.assign((const char*)data.data() + off, entry.internal_len);
+        off += entry.internal_len;
+
+        e.size = entry.size;
+        e.mtime = entry.mtime;
+        e.crc32 = entry.crc32;
+        e.system = (RomSystem)entry.system;
+    }
+
+    log_write("[library] loaded %zu roms\n", entries.size());
+
+    SCOPED_MUTEX(&m_mutex);
+    m_entries = std::make_shared<const RomLibraryEntries>(std::move(entries));
+    m_generation++;
+}
+
+Result RomLibrary::Save(const RomLibraryEntries& entries) {
+    std::vector<u8> data(sizeof(LibraryHeader));
+    const LibraryHeader header{LIBRARY_MAGIC, LIBRARY_VERSION, (u32)entries.size(), 0};
+    std::memcpy(data.data(), &header, sizeof(header));
+
+    for (const auto& e : entries) {
+        const LibraryEntry entry{e.size, e.mtime, e.crc32, e.system, 0, (u16)e.path.length(), (u16)e.internal_name.length(), 0};
+        const auto ptr = (const u8*)&entry;
+        data.insert(data.end(), ptr, ptr + sizeof(entry));
+        data.insert(data.end(), e.path.begin(), e.path.end());
+        data.insert(data.end(), e.internal_name.begin(), e.internal_name.end());
+    }
+
+    // a power loss whilst saving keeps the previous index, otherwise every rom
+    // would be read again to compute its crc.
+    m_fs.CreateDirectoryRecursivelyWithPath(PATH);
+    return SaveStateWriter::WriteFile(PATH, data);
+}
+
+bool RomLibrary::Scan(const std::vector<fs::FsPath>& roots, RomLibraryEntries& out) {
+    TimeStamp ts;
+    const auto old = GetEntries();
+
+    std::unordered_map<std::string_view, const RomLibraryEntry*> old_entries;
+    old_entries.reserve(old->size());
+    for (const auto& e : *old) {
+        old_entries.emplace(e.path, &e);
+    }
+
+    size_t indexed{};
+    std::vector<fs::FsPath> dirs{roots.rbegin(), roots.rend()};
+    std::vector<FsDirectoryEntry> dir_entries;
+
+    while (!dirs.empty()) {
+        const auto dir_path = dirs.back();
+        dirs.pop_back();
+
+        fs::Dir d;
+        if (R_FAILED(m_fs.OpenDirectory(dir_path, FsDirOpenMode_ReadDirs | FsDirOpenMode_ReadFiles, &d)) || R_FAILED(d.ReadAll(dir_entries))) {
+            log_write("[library] failed to read: %s\n", dir_path.s);
+            continue;
+        }
+
+        for (const auto& e : dir_entries) {
+            if (ShouldStop()) {
+                return false;
+            }
+
+            if (e.name[0] == '.') {
+                continue;
+            }
+
+            const auto path = fs::AppendPath(dir_path, e.name);
+            if (e.type == FsDirEntryType_Dir) {
+                dirs.emplace_back(path);
+                continue;
+            }
+
+            const auto ext = GetExtension(e.name);
+            if (!IsRomExtension(ext) && !IsExtension(ext, "zip")) {
+                continue;
+            }
+
+            FsTimeStampRaw time_stamp{};
+            m_fs.GetFileTimeStampRaw(path, &time_stamp);
+
+            const auto it = old_entries.find(path.s);
+            if (it != old_entries.end() && it->second->size == e.file_size && it->second->mtime == time_stamp.modified) {
+                out.emplace_back(*it->second);
+                continue;
+            }
+
+            auto& entry = out.emplace_back();
+            entry.path = path.s;
+            entry.size = e.file_size;
+            entry.mtime = time_stamp.modified;
+            IndexRom(path, entry);
+            indexed++;
+        }
+    }
+
+    std::sort(out.begin(), out.end(), [](auto& lhs, auto& rhs) {
+        return lhs.path < rhs.path;
+    });
+
+    // removed roms also change the index.
+    if (indexed || out.size() != old->size()) {
+        if (R_FAILED(Save(out))) {
+            log_write("[library] failed to save index\n");
+        }
+    }
+
+    log_write("[library] %zu roms, %zu indexed, time taken: %.2fs\n", out.size(), indexed, ts.GetSecondsD());
+    return true;
+}
+
+void RomLibrary::IndexRom(const fs::FsPath& path, RomLibraryEntry& out) {
+    const auto ext = GetExtension(path.s);
+
+    if (IsExtension(ext, "zip")) {
+        fs::FsPath name;
+        if (R_SUCCEEDED(mz::PeekFirstFile(&m_fs, path, name, out.crc32))) {
+            out.internal_name = name.s;
+            out.system = GetSystemFromExtension(GetExtension(name.s));
+        }
+        return;
+    }
+
+    out.system = GetSystemFromExtension(ext);
+
+    fs::File f;
+    if (R_FAILED(m_fs.OpenFile(path, FsOpenMode_Read, &f))) {
+        return;
+    }
+
+    m_read_buf.resize(READ_BUF_SIZE);
+    u32 crc32{};
+    s64 off{};
+    for (;;) {
+        u64 bytes_read{};
+        if (R_FAILED(f.Read(off, m_read_buf.data(), m_read_buf.size(), 0, &bytes_read))) {
+            return;
+        }
+
+        if (!off && out.system == RomSystem_Unknown) {
+            out.system = GetSystemFromHeader({m_read_buf.data(), bytes_read});
+        }
+
+        if (!bytes_read) {
+            break;
+        }
+
+        crc32 = crc32CalculateWithSeed(crc32, m_read_buf.data(), bytes_read);
+        off += bytes_read;
+    }
+
+    out.crc32 = crc32;
+}
+
+} // namespace sphaira
@@ -0,0 +1,122 @@
+#include "trigram_index.hpp"
+#include "reserve_grow.hpp"
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+
+namespace sphaira {
+namespace {
+
+auto Fold(std::string_view in) -> std::string {
+    std::string out(in);
+    for (auto& c : out) {
+        c = std::tolower((unsigned char)c);
+    }
+    return out;
+}
+
+auto GetKey(const char* p) -> u32 {
+    return (u8)p[0] | (u8)p[1] << 8 | (u8)p[2] << 16;
+}
+
+// returns the unique trigrams of the folded string.
+auto GetKeys(std::string_view s) -> std::vector<u32> {
+    std::vector<u32> keys;
+    if (s.length() < 3) {
+        return keys;
+    }
+
+    keys.reserve(s.length() - 2);
+    for (size_t i = 0; i + 3 <= s.length(); i++) {
+        keys.emplace_back(GetKey(s.data() + i));
+    }
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+} // namespace
+
+void TrigramIndex::Clear() {
+    m_names.clear();
+    m_offsets.clear();
+    m_postings.clear();
+}
+
+void TrigramIndex::Reserve(size_t count) {
+    ReserveGrow(m_offsets, count);
+}
+
+auto TrigramIndex::Add(std::string_view name) -> u32 {
+    const u32 id = m_offsets.size();
+    const auto folded = Fold(name);
+
+    m_offsets.emplace_back(m_names.size());
+    m_names += folded;
+    m_names += '\0';
+
+    for (const auto key : GetKeys(folded)) {
+        m_postings[key].emplace_back(id);
+    }
+
+    return id;
+}
+
+auto TrigramIndex::GetName(u32 id) const -> std::string_view {
+    return m_names.data() + m_offsets[id];
+}
+
+auto TrigramIndex::Search(std::string_view query) const -> std::vector<u32> {
+    std::vector<u32> out;
+    const auto folded = Fold(query);
+    if (folded.empty()) {
+        return out;
+    }
+
+    const auto keys = GetKeys(folded);
+
+    // too short to have a trigram, every name is checked.
+    if (keys.empty()) {
+        for (u32 id = 0; id < m_offsets.size(); id++) {
+            if (GetName(id).find(folded) != std::string_view::npos) {
+                out.emplace_back(id);
+            }
+        }
+        return out;
+    }
+
+    std::vector<const std::vector<u32>*> lists;
+    lists.reserve(keys.size());
+    for (const auto key : keys) {
+        const auto it = m_postings.find(key);
+        if (it == m_postings.end()) {
+            return out;
+        }
+        lists.emplace_back(&it->second);
+    }
+
+    // intersect starting with the shortest list, the candidates only shrink.
+    std::sort(lists.begin(), lists.end(), [](auto a, auto b) {
+        return a->size() < b->size();
+    });
+
+    std::vector<u32> candidates = *lists[0];
+    std::vector<u32> tmp;
+    for (size_t i = 1; i < lists.size() && !candidates.empty(); i++) {
+        tmp.clear();
+        std::set_intersection(candidates.begin(), candidates.end(), lists[i]->begin(), lists[i]->end(), std::back_inserter(tmp));
+        std::swap(candidates, tmp);
+    }
+
+    // the trigrams may be in a different order in the name.
+    for (const auto id : candidates) {
+        if (folded.length() == 3 || GetName(id).find(folded) != std::string_view::npos) {
+            out.emplace_back(id);
+        }
+    }
+
+    return out;
+}
+
+} // namespace sphaira
@@ -5,20 +5,23 @@
 #include "ui/option_box.hpp"
 #include "ui/error_box.hpp"
 #include "ui/nvg_util.hpp"
+#include "ui/progress_box.hpp"
 
 #include "app.hpp"
 #include "log.hpp"
 #include "defines.hpp"
 #include "i18n.hpp"
+#include "image.hpp"
 
 #include "emu_helpers/rewind_bar.hpp"
+#include "emu_helpers/qoi_decode.h"
 
 #include <cstring>
 #include <math.h>
 #include <stdlib.h>
 #include <mgb.h>
-#include <lz4.h>
 #include <minIni.h>
+#include <memory>
 
 #if 0
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -76,6 +79,41 @@ static const struct NamedEnum CONFIG_PAR[] = {
     { EmuParType_GG, "Game Gear" },
 };
 
+static const struct NamedEnum CONFIG_AUTOSAVE[] = {
+    { EmuAutoSaveType_OFF, "Off" },
+    { EmuAutoSaveType_30S, "30 seconds" },
+    { EmuAutoSaveType_60S, "60 seconds" },
+    { EmuAutoSaveType_120S, "2 minutes" },
+    { EmuAutoSaveType_300S, "5 minutes" },
+};
+
+static const struct NamedEnum CONFIG_REWIND_CODEC[] = {
+    { EmuRewindCodecType_AUTO, "Auto" },
+    { EmuRewindCodecType_LZ4, "LZ4" },
+    { EmuRewindCodecType_LZ4_FAST, "LZ4 Fast" },
+    { EmuRewindCodecType_LZ4HC, "LZ4HC" },
+    { EmuRewindCodecType_LZ4_DICT, "LZ4 Dictionary" },
+};
+
+static const struct NamedEnum CONFIG_SYNC[] = {
+    { EmuSyncType_VIDEO, "Video" },
+    { EmuSyncType_AUDIO, "Audio" },
+};
+
+static const struct NamedEnum CONFIG_AUDIO_LATENCY[] = {
+    { EmuAudioLatencyType_32MS, "32ms" },
+    { EmuAudioLatencyType_50MS, "50ms" },
+    { EmuAudioLatencyType_100MS, "100ms" },
+    { EmuAudioLatencyType_200MS, "200ms" },
+    { EmuAudioLatencyType_400MS, "400ms" },
+};
+
+static const struct NamedEnum CONFIG_AUDIO_BACKEND[] = {
+    { EmuAudioBackendType_AUDOUT, "Audout" },
+    { EmuAudioBackendType_NULL, "Null" },
+    { EmuAudioBackendType_WAV, "WAV" },
+};
+
 static const struct KeyMap KEY_MAP[2][7] = {
     {
         { HidNpadButton_B, SMS_Button_JOY1_A },
@@ -99,11 +137,11 @@ static const struct KeyMap KEY_MAP[2][7] = {
     }
 };
 
-#define AUDIO_ENTRIES 6
 #define SAMPLE_FREQ 48000
 #define SAMPLE_COUNT (SAMPLE_FREQ / 10 * 2)
+// a frame of samples, so that audio sync can refill buffers at the frame rate.
+#define AUDIO_SYNC_SAMPLE_COUNT (SAMPLE_FREQ / 60 * 2)
 
-AudioOutBuffer audio_buffers[AUDIO_ENTRIES]{};
 bool g_audio_pending{};
 
 struct SDL_Rect {
@@ -115,6 +153,11 @@ static const struct SMS_StateConfig RUNAHEAD_STATE_CONFIG = {
     .include_psg_blip = true,
 };
 
+static const struct SMS_StateConfig SAVESTATE_CONFIG = {
+    .fast = false,
+    .include_psg_blip = true,
+};
+
 static void on_rewind_toggle(Menu* app);
 static void on_speed_reset(Menu* app);
 
@@ -124,6 +167,9 @@ static void on_set_speed(Menu* app, int speed);
 
 static void on_update_sound_playback_state(Menu* app);
 static void on_speed_change(Menu* app);
+static void on_audio_change(Menu* app);
+static void on_audio_backend_change(Menu* app);
+static void core_audio_callback(void* user, int16_t* samples, uint32_t size);
 static bool should_emu_run(const Menu* app);
 
 static void runahead_init(Menu* app, unsigned frames);
@@ -139,6 +185,22 @@ static const float SPEED_TABLE[] = {
     1.25, 1.50, 2.00, 3.00, 4.00,
 };
 
+static const unsigned AUDIO_LATENCY_MS_TABLE[] = {
+    [EmuAudioLatencyType_32MS] = 32,
+    [EmuAudioLatencyType_50MS] = 50,
+    [EmuAudioLatencyType_100MS] = 100,
+    [EmuAudioLatencyType_200MS] = 200,
+    [EmuAudioLatencyType_400MS] = 400,
+};
+
+static const unsigned AUTOSAVE_SECONDS_TABLE[] = {
+    [EmuAutoSaveType_OFF] = 0,
+    [EmuAutoSaveType_30S] = 30,
+    [EmuAutoSaveType_60S] = 60,
+    [EmuAutoSaveType_120S] = 120,
+    [EmuAutoSaveType_300S] = 300,
+};
+
 static const float RATIO_TABLE[] = {
     [EmuParType_AUTO] = 0.0,
     [EmuParType_NONE] = 1.0,
@@ -148,6 +210,41 @@ static const float RATIO_TABLE[] = {
 };
 
 const char* BIOS_PATH = "/switch/TotalSMS/bios.bin";
+// created by the rewind benchmark, used by the lz4 dictionary codec.
+const char* REWIND_DICT_PATH = "/switch/TotalSMS/rewind.dict";
+
+// savestates made before slots existed are in the default mgb path.
+const char* SAVESTATE_PATH = SaveStateIndex::PATH;
+
+// minimum time between battery save writes, flushing on exit and focus loss ignores this.
+constexpr s64 SRAM_FLUSH_INTERVAL_SECONDS = 5;
+
+// frames that fall out of the rewind are stored here, one file per rom.
+const char* REWIND_DISK_PATH = "/switch/TotalSMS/rewind/";
+const char* AUDIO_WAV_PATH = "/switch/TotalSMS/audio/";
+// fat32 limits files to 4GiB.
+constexpr s64 REWIND_DISK_MAX_SIZE = 1024LL * 1024 * 1024 * 2;
+
+// number of keyframes captured by the rewind benchmark.
+enum { REWIND_BENCHMARK_SAMPLES = 16 };
+// lz4 only uses the last 64KiB of a dictionary.
+enum { REWIND_DICT_SIZE = 1024 * 64 };
+
+// seconds of audio captured by the time stretch benchmark.
+constexpr u32 TIME_STRETCH_BENCHMARK_SECONDS = 10;
+
+struct TimeStretchBenchmarkResult {
+    float speed;
+    double ms_per_frame;
+};
+
+struct RewindBenchmarkResult {
+    RewindCodecType type;
+    size_t uncompressed;
+    size_t compressed;
+    double push_ms;
+    double pop_ms;
+};
 
 enum {
     SMS_BPP = 2,
@@ -158,27 +255,6 @@ static uint32_t sms_converted_palette[1 << SMS_BPP * 3];
 static uint32_t gg_converted_palette[1 << GG_BPP * 3];
 static uint32_t sg_converted_palette[1 << 4];
 
-Result audio_init(Menu* app) {
-    R_TRY(audoutInitialize());
-    audoutStartAudioOut();
-
-    alignas(0x1000) static s16 AUDIO_BUFFER[AUDIO_ENTRIES][SAMPLE_COUNT]{};
-    static_assert(std::size(AUDIO_BUFFER) == std::size(audio_buffers));
-
-    std::memset(AUDIO_BUFFER, 0, sizeof(AUDIO_BUFFER));
-    std::memset(audio_buffers, 0, sizeof(audio_buffers));
-
-    for (size_t i = 0; i < std::size(AUDIO_BUFFER); i++) {
-        auto& buf_in = AUDIO_BUFFER[i];
-        auto& buf_out = audio_buffers[i];
-
-        buf_out.buffer = buf_in;
-        buf_out.buffer_size = sizeof(buf_in);
-    }
-
-    R_SUCCEED();
-}
-
 static void input_set(Menu* app, bool down, uint16_t value) {
     if (!should_emu_run(app)) {
         return;
@@ -205,24 +281,53 @@ static void input_apply(Menu* app) {
     app->inputs[1] = app->inputs[0];
 }
 
-static size_t compressor_size_lz4(size_t src_size) {
-    return LZ4_compressBound(src_size);
+// returns the codecs to measure in auto mode, the dictionary codec
+// is last in the array and is skipped if there's no dictionary.
+static auto rewind_get_auto_codecs(Menu* app) -> std::span<RewindCodec> {
+    std::span<RewindCodec> codecs{app->rewind_codecs};
+    if (app->rewind_dict.empty()) {
+        return codecs.first(RewindCodecType_LZ4_DICT);
+    }
+    return codecs;
 }
 
-static size_t compressor_lz4(const void* src_data, void* dst_data, size_t src_size, size_t dst_size, bool inflate_mode) {
-    int result;
+static void rewind_apply_codec(Menu* app) {
+    if (!app->rewind) {
+        return;
+    }
 
-    if (inflate_mode) {
-        result = LZ4_decompress_safe((const char*)src_data, (char*)dst_data, src_size, dst_size);
+    auto type = app->m_rewind_codec.Get();
+    if (type == EmuRewindCodecType_AUTO) {
+        if (app->rewind_worker.IsRunning()) {
+            app->rewind_worker.SetAutoSelect(rewind_get_auto_codecs(app));
+            return;
+        }
+
+        // measuring is done on the worker, so fallback to the default.
+        type = EmuRewindCodecType_LZ4;
+    }
+
+    auto codec = &app->rewind_codecs[type - EmuRewindCodecType_LZ4];
+    if (app->rewind_worker.IsRunning()) {
+        app->rewind_worker.SetCodec(codec);
     } else {
-        result = LZ4_compress_default((const char*)src_data, (char*)dst_data, src_size, dst_size);
+        rewind_set_compressor(app->rewind, rewind_codec_compressor, rewind_codec_compressor_size, codec);
     }
+}
 
-    if (result <= 0) {
-        return 0;
+static void rewind_load_codecs(Menu* app) {
+    app->rewind_dict.clear();
+    if (R_SUCCEEDED(fs::read_entire_file(REWIND_DICT_PATH, app->rewind_dict))) {
+        log_write("[rewind] loaded dictionary: %zu bytes\n", app->rewind_dict.size());
     }
 
-    return result;
+    for (int i = 0; i < RewindCodecType_MAX; i++) {
+        rewind_codec_init(&app->rewind_codecs[i], (RewindCodecType)i);
+    }
+
+    auto& dict_codec = app->rewind_codecs[RewindCodecType_LZ4_DICT];
+    dict_codec.dict = app->rewind_dict.data();
+    dict_codec.dict_size = app->rewind_dict.size();
 }
 
 static bool update_screen_and_renderer_size(Menu* app) {
@@ -255,14 +360,456 @@ static bool update_screen_and_renderer_size(Menu* app) {
     return true;
 }
 
-static void on_rom_load(Menu* app) {
-    rewind_bar_set_open(app, false);
+static bool rewind_get_menu_stats(Menu* app, RewindStats* stats) {
+    if (!app->rewind) {
+        return false;
+    }
+
+    if (app->rewind_worker.IsRunning()) {
+        app->rewind_worker.GetStats(stats);
+    } else {
+        rewind_get_stats(app->rewind, stats);
+    }
+
+    return true;
+}
+
+static void rewind_log_latency(const char* name, const RewindLatency& l) {
+    log_write("[rewind] %s: count: %llu p50: %.2fms p90: %.2fms p99: %.2fms max: %.2fms\n", name, (unsigned long long)l.count, l.p50_ns / 1e+6, l.p90_ns / 1e+6, l.p99_ns / 1e+6, l.max_ns / 1e+6);
+}
+
+static void rewind_log_stats(Menu* app) {
+    RewindStats stats;
+    if (!rewind_get_menu_stats(app, &stats)) {
+        return;
+    }
+
+    log_write("[rewind] frames: %zu spilled: %zu size: %.2f MiB ratio: %.2f%%\n", stats.count, stats.spill_count, stats.compressed / 1024.0 / 1024.0, stats.uncompressed ? (double)stats.compressed / (double)stats.uncompressed * 100.0 : 0.0);
+    for (int i = 0; i < REWIND_STATS_RATIO_BUCKETS; i++) {
+        log_write("[rewind] ratio %d-%d%%: %zu\n", i * 100 / REWIND_STATS_RATIO_BUCKETS, (i + 1) * 100 / REWIND_STATS_RATIO_BUCKETS, stats.ratio_histogram[i]);
+    }
+    rewind_log_latency("push", stats.push);
+    rewind_log_latency("pop", stats.pop);
+    rewind_log_latency("get", stats.get);
+}
+
+static void rewind_stats_render(NVGcontext* vg, Menu* app) {
+    RewindStats stats;
+    if (!rewind_get_menu_stats(app, &stats)) {
+        return;
+    }
+
+    char histogram[REWIND_STATS_RATIO_BUCKETS * 8]{};
+    for (int i = 0, off = 0; i < REWIND_STATS_RATIO_BUCKETS; i++) {
+        off += std::snprintf(histogram + off, sizeof(histogram) - off, "%zu ", stats.ratio_histogram[i]);
+    }
+
+    const float font_size = 18;
+    const float x = 10;
+    float y = 10;
+    const auto colour = nvgRGB(255, 255, 255);
+
+    gfx::drawRect(vg, 0, 0, 620, y * 2 + font_size * 4, nvgRGBA(0, 0, 0, 180));
+    gfx::drawTextArgs(vg, x, y, font_size, NVG_ALIGN_LEFT | NVG_ALIGN_TOP, colour, "frames: %zu sd: %zu size: %.2f MiB ratio: %.2f%%", stats.count, stats.spill_count, stats.compressed / 1024.0 / 1024.0, stats.uncompressed ? (double)stats.compressed / (double)stats.uncompressed * 100.0 : 0.0);
+    y += font_size;
+    gfx::drawTextArgs(vg, x, y, font_size, NVG_ALIGN_LEFT | NVG_ALIGN_TOP, colour, "ratio 0-100%%: %s", histogram);
+    y += font_size;
+    gfx::drawTextArgs(vg, x, y, font_size, NVG_ALIGN_LEFT | NVG_ALIGN_TOP, colour, "push p50: %.2fms p99: %.2fms pop p50: %.2fms p99: %.2fms", stats.push.p50_ns / 1e+6, stats.push.p99_ns / 1e+6, stats.pop.p50_ns / 1e+6, stats.pop.p99_ns / 1e+6);
+    y += font_size;
+    gfx::drawTextArgs(vg, x, y, font_size, NVG_ALIGN_LEFT | NVG_ALIGN_TOP, colour, "get p50: %.2fms p99: %.2fms max: %.2fms", stats.get.p50_ns / 1e+6, stats.get.p99_ns / 1e+6, stats.get.max_ns / 1e+6);
+}
+
+static void audio_log_stats(Menu* app) {
+    const auto stats = app->audio_out->GetStats();
+    log_write("[audio] underruns: %u dropped: %u / %u queue avg: %.2f max: %u limit: %u latency avg: %.2fms max: %.2fms\n",
+        stats.underruns, stats.dropped, stats.submitted, stats.queue_depth_avg, stats.queue_depth_max, stats.max_queued, stats.latency_avg_ms, stats.latency_max_ms);
+}
+
+static void audio_update_frame_time(Menu* app, double delta) {
+    app->frame_time_ms = delta * 1000.0;
+    // the max is kept for a second so that a single slow frame can be seen.
+    if (app->frame_time_ts.GetSeconds() >= 1) {
+        app->frame_time_ts.Update();
+        app->frame_time_max_ms = 0;
+    }
+    app->frame_time_max_ms = std::max(app->frame_time_max_ms, app->frame_time_ms);
+}
+
+static void audio_stats_render(NVGcontext* vg, Menu* app) {
+    const auto stats = app->audio_out->GetStats();
+
+    const float font_size = 18;
+    const float h = 10 * 2 + font_size * 3;
+    const float x = 10;
+    float y = SCREEN_HEIGHT - h + 10;
+    const auto colour = nvgRGB(255, 255, 255);
+
+    gfx::drawRect(vg, 0, SCREEN_HEIGHT - h, 760, h, nvgRGBA(0, 0, 0, 180));
+    gfx::drawTextArgs(vg, x, y, font_size, NVG_ALIGN_LEFT | NVG_ALIGN_TOP, colour, "underruns: %u dropped: %u / %u blocks", stats.underruns, stats.dropped, stats.submitted);
+    y += font_size;
+    gfx::drawTextArgs(vg, x, y, font_size, NVG_ALIGN_LEFT | NVG_ALIGN_TOP, colour, "queue: %u avg: %.2f max: %u limit: %u", stats.queue_depth, stats.queue_depth_avg, stats.queue_depth_max, stats.max_queued);
+    y += font_size;
+    gfx::drawTextArgs(vg, x, y, font_size, NVG_ALIGN_LEFT | NVG_ALIGN_TOP, colour, "latency: %.2fms avg: %.2fms max: %.2fms frame: %.2fms max: %.2fms", stats.latency_ms, stats.latency_avg_ms, stats.latency_max_ms, app->frame_time_ms, app->frame_time_max_ms);
+}
+
+// closes the rewind, moving every frame to disk if the history is to be resumed.
+static void rewind_exit(Menu* app) {
+    // must be closed before the rewind as it may still be pushing frames.
+    app->rewind_worker.Exit();
+    rewind_log_stats(app);
+
+    const auto keep = app->m_rewind_disk_resume.Get();
+    if (app->rewind && app->rewind_disk.IsRunning() && keep) {
+        rewind_spill_all(app->rewind);
+    }
+    app->rewind_disk.Exit(keep);
 
-    // free rewind and rewind buffer.
     if (app->rewind) {
         rewind_close(app->rewind);
+        app->rewind = NULL;
+    }
+}
+
+static auto get_rom_file_name(Menu* app) -> const char* {
+    const auto& rom_path = app->GetRomPath();
+    const char* name = std::strrchr(rom_path, '/');
+    return name ? name + 1 : rom_path.s;
+}
+
+// savestates and rewind history are stored under this, see SaveStateIndex::GetRomName().
+static auto get_rom_save_name(Menu* app) -> fs::FsPath {
+    return SaveStateIndex::GetRomName(app->GetRomPath());
+}
+
+static auto audio_create_sink(Menu* app) -> std::unique_ptr<AudioSink> {
+    switch (app->m_audio_backend.Get()) {
+        case EmuAudioBackendType_NULL:
+            return std::make_unique<AudioSinkNull>(SAMPLE_FREQ, SAMPLE_COUNT);
+
+        case EmuAudioBackendType_WAV: {
+            const auto path = fs::FsPath{AUDIO_WAV_PATH} + get_rom_file_name(app) + ".wav";
+            fs::FsNativeSd().CreateDirectoryRecursivelyWithPath(path);
+
+            auto sink = std::make_unique<AudioSinkWav>(SAMPLE_FREQ, SAMPLE_COUNT);
+            if (!sink->Open(path)) {
+                log_write("[audio] failed to open wav: %s\n", path.s);
+            }
+            return sink;
+        }
+    }
+
+    auto sink = std::make_unique<AudioOut>();
+    if (R_FAILED(sink->Init(SAMPLE_FREQ, SAMPLE_COUNT))) {
+        log_write("[audio] failed to init audout\n");
+        return {};
+    }
+    return sink;
+}
+
+static void rewind_disk_init(Menu* app) {
+    if (!app->m_rewind_disk.Get()) {
+        return;
+    }
+
+    const auto path = fs::FsPath{REWIND_DISK_PATH} + get_rom_save_name(app) + ".rwd";
+
+    if (R_FAILED(app->rewind_disk.Init(path, app->rewind_buffer_size, REWIND_DISK_MAX_SIZE, app->rewind_codecs, app->m_rewind_disk_resume.Get()))) {
+        log_write("[rewind] failed to open disk: %s\n", path.s);
+        return;
+    }
+
+    rewind_set_spill(app->rewind, app->rewind_disk.GetSpill());
+}
+
+static auto savestate_get_path(const fs::FsPath& name, u32 slot) -> fs::FsPath {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), ".%u.state", slot);
+    return fs::FsPath{SAVESTATE_PATH} + name + buf;
+}
+
+static auto savestate_get_path(Menu* app, u32 slot) -> fs::FsPath {
+    return savestate_get_path(get_rom_save_name(app), slot);
+}
+
+// savestates used to be stored under the file name of the rom, so roms with the
+// same name shared them. they are moved to the new name the first time the rom is opened.
+static void savestate_migrate_names(Menu* app) {
+    fs::FsNativeSd fs;
+    const auto& rom_path = app->GetRomPath();
+    const auto index_path = SaveStateIndex::GetIndexPath(rom_path);
+    const auto legacy_index_path = SaveStateIndex::GetLegacyIndexPath(rom_path);
+    if (fs.FileExists(index_path) || !fs.FileExists(legacy_index_path)) {
+        return;
+    }
+
+    const char* name = std::strrchr(rom_path, '/');
+    const fs::FsPath legacy_name{name ? name + 1 : rom_path.s};
+    const auto new_name = get_rom_save_name(app);
+
+    fs.RenameFile(legacy_index_path, index_path);
+    for (u32 i = 0; i < SaveStateIndex::SLOT_COUNT; i++) {
+        fs.RenameFile(savestate_get_path(legacy_name, i), savestate_get_path(new_name, i));
+    }
+    fs.RenameFile(fs::FsPath{REWIND_DISK_PATH} + legacy_name + ".rwd", fs::FsPath{REWIND_DISK_PATH} + new_name + ".rwd");
+
+    log_write("[savestate] moved savestates of %s to %s\n", legacy_name.s, new_name.s);
+}
+
+// snapshots the state and frame, the savestate is written on the writer thread.
+static bool savestate_create(Menu* app, u32 slot) {
+    SaveStateJob job;
+    job.path = savestate_get_path(app, slot);
+    job.timestamp = time(NULL);
+    job.state.resize(SMS_get_state_size(&app->sms, &SAVESTATE_CONFIG));
+    if (!SMS_savestate(&app->sms, job.state.data(), job.state.size(), &SAVESTATE_CONFIG)) {
+        return false;
+    }
+
+    SDL_Rect rect;
+    SMS_get_pixel_region(&app->sms, &rect.x, &rect.y, &rect.w, &rect.h);
+    const auto pixels = (const u32*)app->pixel_buffer[app->pixel_buffer_index] + rect.y * SMS_SCREEN_WIDTH + rect.x;
+
+    job.w = rect.w;
+    job.h = rect.h;
+    job.pixels.resize(job.w * job.h);
+    for (u32 y = 0; y < job.h; y++) {
+        std::memcpy(job.pixels.data() + y * job.w, pixels + y * SMS_SCREEN_WIDTH, job.w * sizeof(u32));
+    }
+
+    app->savestate_index.Set(slot, job.timestamp, pixels, rect.w, rect.h, SMS_SCREEN_WIDTH);
+    job.extra_path = app->savestate_index.GetPath();
+    job.extra = app->savestate_index.Serialize();
+
+    app->savestate_writer.Push(std::move(job));
+    return true;
+}
+
+static bool savestate_load(Menu* app, u32 slot) {
+    // the savestate may still be being written.
+    app->savestate_writer.Flush();
+
+    std::vector<u8> data;
+    if (R_FAILED(SaveStateWriter::ReadFile(savestate_get_path(app, slot), data))) {
+        // savestates made before slots existed.
+        return !slot && mgb_load_state_file(NULL);
+    }
+
+    SaveStateHeader header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != SaveStateHeader::MAGIC || header.version != SaveStateHeader::VERSION || data.size() < sizeof(header) + header.state_size) {
+        return false;
+    }
+
+    if (!SMS_loadstate(&app->sms, data.data() + sizeof(header), header.state_size, &SAVESTATE_CONFIG)) {
+        return false;
+    }
+
+    on_set_rewind(app, false);
+    return true;
+}
+
+// rebuilds the index from the thumbnail stored after each savestate, used when
+// the index is missing or could not be read.
+static void savestate_index_rebuild(Menu* app) {
+    const auto name = get_rom_save_name(app);
+    bool changed{};
+
+    for (u32 i = 0; i < SaveStateIndex::SLOT_COUNT; i++) {
+        std::vector<u8> data;
+        if (R_FAILED(SaveStateWriter::ReadFile(savestate_get_path(name, i), data))) {
+            continue;
+        }
+
+        SaveStateHeader header;
+        if (data.size() < sizeof(header)) {
+            continue;
+        }
+
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (header.magic != SaveStateHeader::MAGIC || header.version != SaveStateHeader::VERSION || data.size() - sizeof(header) < (u64)header.state_size + header.thumbnail_size) {
+            continue;
+        }
+
+        // the savestate can still be loaded without a thumbnail.
+        u32 w{}, h{};
+        auto pixels = qoi_decode_rgba(data.data() + sizeof(header) + header.state_size, header.thumbnail_size, &w, &h);
+        ON_SCOPE_EXIT(std::free(pixels));
+        if (!pixels) {
+            w = h = 0;
+        }
+
+        app->savestate_index.Set(i, header.timestamp, pixels, w, h, w);
+        changed = true;
+    }
+
+    if (changed) {
+        log_write("[savestate] rebuilt index from savestates\n");
+        if (R_FAILED(app->savestate_index.Save())) {
+            log_write("[savestate] failed to save index\n");
+        }
+    }
+}
+
+// adds the first slot to the index if it was created before the index existed.
+// this is the only time the savestate is parsed and its png decoded.
+static void savestate_index_add_legacy(Menu* app) {
+    if (app->savestate_index.Get(0).used) {
+        return;
     }
 
+    auto info = mgb_load_state_info_file(NULL, true);
+    if (!info) {
+        return;
+    }
+    ON_SCOPE_EXIT(mgb_free_state_info(info));
+
+    const auto image = ImageLoadFromMemory({info->png, info->png_size});
+    if (image.data.empty()) {
+        return;
+    }
+
+    app->savestate_index.Set(0, info->meta.timestamp, (const u32*)image.data.data(), image.w, image.h, image.w);
+    if (R_FAILED(app->savestate_index.Save())) {
+        log_write("[savestate] failed to save index\n");
+    }
+}
+
+static auto savestate_get_title(const SaveStateSlot& slot, u32 index) -> std::string {
+    char buf[128];
+
+    const auto name = SaveStateIndex::IsAutoSlot(index) ? "Auto"_i18n : "Slot"_i18n;
+    if (SaveStateIndex::IsAutoSlot(index)) {
+        index -= SaveStateIndex::USER_SLOT_COUNT;
+    }
+
+    if (!slot.used) {
+        std::snprintf(buf, sizeof(buf), "%s %u - %s", name.c_str(), index + 1, "Empty"_i18n.c_str());
+    } else {
+        const time_t timestamp = slot.timestamp;
+        const struct tm* tm = localtime(&timestamp);
+        std::snprintf(buf, sizeof(buf), "%s %u - %02u/%02u/%04u - %02u:%02u:%02u", name.c_str(), index + 1, tm->tm_mday, tm->tm_mon + 1, tm->tm_year + 1900, tm->tm_hour, tm->tm_min, tm->tm_sec);
+    }
+
+    return buf;
+}
+
+static void autosave_reset(Menu* app) {
+    const auto seconds = AUTOSAVE_SECONDS_TABLE[app->m_autosave.Get()];
+    app->autosave_counter = seconds * SMS_target_fps(&app->sms);
+    app->autosave_should_save = false;
+}
+
+// the snapshot takes well under a frame, writing is done on the writer thread.
+static void autosave_create(Menu* app) {
+    const auto slot = app->savestate_index.GetNextAutoSlot();
+    if (!savestate_create(app, slot)) {
+        log_write("[savestate] failed to auto save to slot: %u\n", slot);
+    }
+}
+
+static auto sram_hash(std::span<const u8> data) -> u64 {
+    // fnv-1a.
+    u64 hash = 0xCBF29CE484222325;
+    for (const auto c : data) {
+        hash = (hash ^ c) * 0x100000001B3;
+    }
+    return hash;
+}
+
+// the whole sram is hashed until the size is known, so that changes are still seen.
+static auto sram_get(Menu* app) -> std::span<const u8> {
+    return {(const u8*)app->sms.cart.ram, app->sram_size ? app->sram_size : sizeof(app->sms.cart.ram)};
+}
+
+// mgb decides the layout of the save, the snapshot is written with the same
+// path and size as the file that mgb loaded or saved.
+static void sram_set_file(Menu* app, const char* file_name) {
+    app->sram_path = file_name;
+
+    FsTimeStampRaw ts;
+    s64 size;
+    if (R_SUCCEEDED(fs::FsNativeSd().FileGetSizeAndTimestamp(app->sram_path, &ts, &size)) && size > 0) {
+        app->sram_size = std::min<size_t>(size, sizeof(app->sms.cart.ram));
+    }
+}
+
+// mgb found no save, the sram may have been left in a .tmp or .bak file
+// if power was lost whilst it was written.
+static bool sram_recover(Menu* app) {
+    std::vector<u8> data;
+    if (app->sram_path.empty() || R_FAILED(SaveStateWriter::ReadFile(app->sram_path, data))) {
+        return false;
+    }
+
+    app->sram_size = std::min(data.size(), sizeof(app->sms.cart.ram));
+    std::memcpy(app->sms.cart.ram, data.data(), app->sram_size);
+    log_write("[sram] recovered: %s\n", app->sram_path.s);
+    return true;
+}
+
+static void sram_reset(Menu* app) {
+    app->sram_flushed_hash = sram_hash(sram_get(app));
+    app->sram_flush_ts.Update();
+}
+
+// the sram is compared against the last flush rather than tracking every write,
+// hashing it is cheap compared to a write, which is done on the writer thread.
+static void sram_flush(Menu* app, bool force) {
+    if (!mgb_has_rom() || !SMS_used_sram(&app->sms) || app->sram_path.empty()) {
+        return;
+    }
+
+    if (!force && app->sram_flush_ts.GetSeconds() < SRAM_FLUSH_INTERVAL_SECONDS) {
+        return;
+    }
+
+    app->sram_flush_ts.Update();
+    const auto sram = sram_get(app);
+    const auto hash = sram_hash(sram);
+    if (hash == app->sram_flushed_hash) {
+        return;
+    }
+
+    // the first save is written by mgb, which sets the size, see sram_set_file().
+    if (!app->sram_size) {
+        if (!mgb_save_save_file(app->sram_path)) {
+            log_write("[sram] failed to save: %s\n", app->sram_path.s);
+        }
+        return;
+    }
+
+    SaveStateJob job{};
+    job.extra_path = app->sram_path;
+    job.extra.assign(sram.begin(), sram.end());
+    app->savestate_writer.Push(std::move(job));
+    app->sram_flushed_hash = hash;
+}
+
+// the thumbnail is already decoded, so this is just an upload.
+static auto savestate_create_image(const SaveStateSlot& slot) -> int {
+    if (slot.thumbnail.empty()) {
+        return 0;
+    }
+
+    return nvgCreateImageRGBA(App::GetVg(), slot.thumbnail_w, slot.thumbnail_h, 0, slot.thumbnail.data());
+}
+
+static void on_rom_load(Menu* app) {
+    rewind_bar_set_open(app, false);
+
+    // an empty index is fine, it will be created when a savestate is.
+    savestate_migrate_names(app);
+    if (R_FAILED(app->savestate_index.Load(SaveStateIndex::GetIndexPath(app->GetRomPath())))) {
+        savestate_index_rebuild(app);
+    }
+
+    // free rewind and rewind buffer.
+    rewind_exit(app);
+
     if (app->rewind_buffer) {
         free(app->rewind_buffer);
         app->rewind_pixel_buffer = NULL;
@@ -272,26 +819,37 @@ static void on_rom_load(Menu* app) {
     // reset rewind state and create savestate config.
     app->rewind_counter = 0;
     app->rewind_should_push = false;
+    autosave_reset(app);
+    sram_reset(app);
     app->rewind_state_config.include_psg_blip = true;
     app->rewind_state_config.fast = false;
 
-    // allocate new rewind buffer.
-    app->rewind_buffer_size = app->pixel_buffer_size;
+    // allocate new rewind buffer, the frame is stored indexed.
+    app->rewind_buffer_size = rewind_frame_get_size(SMS_SCREEN_WIDTH, SMS_SCREEN_HEIGHT);
     app->rewind_buffer_size += SMS_get_state_size(&app->sms, &app->rewind_state_config);
     app->rewind_buffer = malloc(app->rewind_buffer_size);
 
     // setup pointers.
     app->rewind_pixel_buffer = app->rewind_buffer;
-    app->rewind_pixel_buffer_size = app->pixel_buffer_size;
+    app->rewind_pixel_buffer_size = rewind_frame_get_size(SMS_SCREEN_WIDTH, SMS_SCREEN_HEIGHT);
     app->rewind_state_buffer = (uint8_t*)app->rewind_buffer + app->rewind_pixel_buffer_size;
     app->rewind_state_buffer_size = app->rewind_buffer_size - app->rewind_pixel_buffer_size;
 
     // finally, create rewind.
+    rewind_load_codecs(app);
     const size_t count = 60 * app->rewind_num_seconds / app->rewind_keyframe_interval;
-    app->rewind = rewind_init(app->rewind_buffer_size, count, compressor_lz4, compressor_size_lz4);
+    app->rewind = rewind_init(app->rewind_buffer_size, count, rewind_codec_compressor, rewind_codec_compressor_size, &app->rewind_codecs[RewindCodecType_LZ4]);
+    if (app->rewind && R_FAILED(app->rewind_worker.Init(app->rewind, app->rewind_buffer_size))) {
+        log_write("[rewind] failed to create worker, pushing on the main thread\n");
+    }
+    if (app->rewind) {
+        rewind_disk_init(app);
+    }
+    rewind_apply_codec(app);
 
     // we don't want to play left over audio data from the previous game.
-    audoutFlushAudioOutBuffers(NULL);
+    app->audio_out->Flush();
+    app->audio_out->ResetStats();
 
     // clear the frame buffers.
     memset(app->pixel_buffer[0], 0, app->pixel_buffer_size);
@@ -324,6 +882,16 @@ static void mgb_on_file_callback(void* user, const char* file_name, enum Callbac
             break;
 
         case CallbackType_LOAD_SAVE:
+            // mgb writes the save to the same path it loaded it from.
+            app->sram_size = 0;
+            sram_set_file(app, file_name);
+            if (!result && sram_recover(app)) {
+                sram_reset(app);
+                // written back to the main file on the next flush.
+                app->sram_flushed_hash = 0;
+            } else {
+                sram_reset(app);
+            }
             if (result) {
                 // App::Notify("Loaded Save");
             } else {
@@ -342,6 +910,8 @@ static void mgb_on_file_callback(void* user, const char* file_name, enum Callbac
 
         case CallbackType_SAVE_SAVE:
             if (result) {
+                sram_set_file(app, file_name);
+                sram_reset(app);
             } else {
                 App::Notify("Failed to save save file");
             }
@@ -468,6 +1038,10 @@ static void core_vblank_callback(void* user, uint32_t overscan_colour) {
         app->rewind_counter--;
     }
 
+    if (app->autosave_counter && !--app->autosave_counter) {
+        app->autosave_should_save = true;
+    }
+
     if (SMS_get_skip_frame(&app->sms)) {
         return;
     }
@@ -478,39 +1052,87 @@ static void core_vblank_callback(void* user, uint32_t overscan_colour) {
     SMS_set_pixels(&app->sms, app->pixel_buffer[app->pixel_buffer_index ^ 1], SMS_SCREEN_WIDTH, sizeof(u32));
 }
 
-static void core_audio_callback(void* user, int16_t* samples, uint32_t size) {
-    // Menu* app = (Menu*)user;
+// dropped blocks are counted in the audio stats.
+static bool audio_push(Menu* app, const int16_t* samples, uint32_t size) {
+    return app->audio_out->Submit(samples, size);
+}
 
-    const auto push_buf = [&](AudioOutBuffer& buf_out) -> Result {
-        buf_out.data_size = size * sizeof(*samples);
-        memcpy(buf_out.buffer, samples, buf_out.data_size);
+static void audio_set_core_buffer(Menu* app, int16_t* buffer) {
+    app->core_audio_buffer = buffer ? buffer : app->sample_data;
+    SMS_set_apu_callback(&app->sms, core_audio_callback, app->core_audio_buffer, app->sample_block_size, SAMPLE_FREQ);
+}
 
-        armDCacheFlush(buf_out.buffer, buf_out.data_size);
-        return audoutAppendAudioOutBuffer(&buf_out);
-    };
+static bool time_stretch_is_enabled(Menu* app) {
+    return app->time_stretch && app->m_time_stretch.Get() && app->speed_index != SPEED_DEFAULT_INDEX;
+}
 
-    for (auto& buf_out : audio_buffers) {
-        bool contains;
-        if (R_SUCCEEDED(audoutContainsAudioOutBuffer(&buf_out, &contains)) && !contains) {
-            log_write("[audio] found empty buffer\n");
-            push_buf(buf_out);
-            return;
-        }
+// gives the core an audout buffer to write into, unless the samples need processing first.
+static void audio_update_core_buffer(Menu* app) {
+    if (app->core_audio_buffer != app->sample_data) {
+        app->audio_out->Release(app->core_audio_buffer);
     }
 
-    AudioOutBuffer* released{};
-    u32 ReleasedBuffersCount{};
-    if (R_FAILED(audoutGetReleasedAudioOutBuffer(&released, &ReleasedBuffersCount))) {
-        log_write("[audio] failed to get released\n");
+    if (time_stretch_is_enabled(app) || app->audio_capture) {
+        audio_set_core_buffer(app, app->sample_data);
+    } else {
+        audio_set_core_buffer(app, app->audio_out->Acquire());
+    }
+}
+
+static void time_stretch_apply(Menu* app) {
+    if (app->time_stretch) {
+        time_stretch_reset(app->time_stretch);
+        time_stretch_set_ratio(app->time_stretch, SPEED_TABLE[app->speed_index]);
+        app->time_stretch_count = 0;
+    }
+
+    audio_update_core_buffer(app);
+}
+
+static void core_audio_callback(void* user, int16_t* samples, uint32_t size) {
+    Menu* app = (Menu*)user;
+
+    if (app->audio_capture) {
+        app->audio_capture->insert(app->audio_capture->end(), samples, samples + size);
         return;
     }
 
-    if (!ReleasedBuffersCount) {
-        log_write("[audio] dropping samples...\n");
+    if (!time_stretch_is_enabled(app)) {
+        // the samples were written into an audout buffer, so queue it in place
+        // and have the core write the next block into a free one.
+        // if the queue is full the block is dropped and the buffer reused.
+        if (samples != app->sample_data) {
+            if (audio_push(app, samples, size)) {
+                audio_set_core_buffer(app, app->audio_out->Acquire());
+            }
+            return;
+        }
+
+        // no buffer was free last time, so the block was copied, try again.
+        audio_push(app, samples, size);
+        if (auto buffer = app->audio_out->Acquire()) {
+            audio_set_core_buffer(app, buffer);
+        }
         return;
     }
 
-    push_buf(released[0]);
+    // the core produces audio at the emulated speed, stretch it back to 1x and
+    // queue it in blocks of the same size as the core uses.
+    time_stretch_push(app->time_stretch, samples, size / 2);
+
+    for (;;) {
+        const auto max_frames = (app->sample_block_size - app->time_stretch_count) / 2;
+        const auto frames = time_stretch_pull(app->time_stretch, app->time_stretch_buffer + app->time_stretch_count, max_frames);
+        if (!frames) {
+            break;
+        }
+
+        app->time_stretch_count += frames * 2;
+        if (app->time_stretch_count == app->sample_block_size) {
+            audio_push(app, app->time_stretch_buffer, app->time_stretch_count);
+            app->time_stretch_count = 0;
+        }
+    }
 }
 
 static void sdl_poll_emu_inputs(Menu* app) {
@@ -577,6 +1199,10 @@ static void on_set_pause(Menu* app, bool enable) {
 
 static void on_set_rewind(Menu* app, bool enable) {
     if (enable != rewind_bar_enabled()) {
+        if (enable) {
+            rewind_log_stats(app);
+        }
+
         rewind_bar_set_open(app, enable);
         on_update_sound_playback_state(app);
     }
@@ -592,9 +1218,9 @@ static void on_set_speed(Menu* app, int speed) {
 
 static void on_update_sound_playback_state(Menu* app) {
     if (should_emu_run(app)) {
-        audoutStartAudioOut();
+        app->audio_out->Start();
     } else {
-        audoutStopAudioOut();
+        app->audio_out->Stop();
     }
 }
 
@@ -605,11 +1231,48 @@ static void on_speed_change(Menu* app) {
     App::Notify(buf);
 
     // clear audio as we may go 8x -> 1x which would fill the buffers.
-    // todo: resample audio for non 1x speed.
-    audoutFlushAudioOutBuffers(NULL);
+    app->audio_out->Flush();
+    time_stretch_apply(app);
     app->audio_shared_data.speed_index = app->speed_index;
 }
 
+static void on_audio_change(Menu* app) {
+    const auto latency_ms = AUDIO_LATENCY_MS_TABLE[app->m_audio_latency.Get()];
+
+    if (app->m_sync.Get() == EmuSyncType_AUDIO) {
+        // audio sync refills at the frame rate, otherwise it would run in bursts.
+        app->sample_block_size = AUDIO_SYNC_SAMPLE_COUNT;
+    } else {
+        // about 3 blocks fit in the latency target, between a frame and 100ms each.
+        const u32 block_size = SAMPLE_FREQ * 2 * latency_ms / 1000 / 3;
+        app->sample_block_size = std::clamp<u32>(block_size & ~1, AUDIO_SYNC_SAMPLE_COUNT, SAMPLE_COUNT);
+    }
+
+    app->audio_out->Configure(app->sample_block_size, latency_ms);
+    // this sets the new block size in the core.
+    time_stretch_apply(app);
+}
+
+static void on_audio_backend_change(Menu* app) {
+    // the core may be writing into a buffer owned by the old sink.
+    if (app->core_audio_buffer != app->sample_data) {
+        app->audio_out->Release(app->core_audio_buffer);
+    }
+    audio_set_core_buffer(app, app->sample_data);
+
+    // the old sink is destroyed first, audout can only be opened once.
+    app->audio_out.reset();
+    app->audio_out = audio_create_sink(app);
+    if (!app->audio_out) {
+        App::Notify("Failed to open audio output, using Null"_i18n);
+        app->m_audio_backend.Set(EmuAudioBackendType_NULL);
+        app->audio_out = audio_create_sink(app);
+    }
+
+    on_audio_change(app);
+    on_update_sound_playback_state(app);
+}
+
 static bool should_emu_run(const Menu* app) {
     return mgb_has_rom() && !app->paused && app->focus && !rewind_bar_enabled();
 }
@@ -712,6 +1375,29 @@ static void runahead_clear_frames(Menu* app) {
     app->runahead.count = 0;
 }
 
+// runahead and speed change the amount of audio produced per frame, so they use video sync.
+static bool audio_sync_is_enabled(Menu* app) {
+    return app->m_sync.Get() == EmuSyncType_AUDIO && app->m_audio_backend.Get() == EmuAudioBackendType_AUDOUT && app->speed_index == SPEED_DEFAULT_INDEX && !runahead_is_enabled(app);
+}
+
+// runs the emulator for exactly as long as it takes to refill the released audio buffers.
+// frames are presented whenever they complete, so video may skip or repeat a frame.
+static void audio_sync_run(Menu* app) {
+    if (!should_emu_run(app)) {
+        return;
+    }
+
+    const double cycles_per_second = (double)SMS_cycles_per_frame(&app->sms) * SMS_target_fps(&app->sms);
+    const double cycles = cycles_per_second * (AUDIO_SYNC_SAMPLE_COUNT / 2) / SAMPLE_FREQ;
+
+    // capped so that a stalled audout cannot stall the ui.
+    for (u32 i = 0; i < AudioOut::MAX_BUFFERS && app->audio_out->GetFreeCount(); i++) {
+        emulator_run(app, cycles, false, false, false);
+    }
+
+    runahead_clear_frames(app);
+}
+
 // run the emulate for a single frame.
 // will exit early if the emulate is paused or no rom etc.
 // if runahead is disabled, then it will run a frame as normal.
@@ -784,6 +1470,189 @@ static void runahead_run_frame(Menu* app, double delta) {
     }
 }
 
+// captures keyframes from the loaded rom, then measures the ratio and push / pop
+// time of every codec on them.
+// the dictionary is built from a separate set of keyframes to the ones measured,
+// so that LZ4_DICT is not measured on its own data.
+// this runs on the progress box thread, the menu is not updated whilst the box
+// is open so the core is safe to use here.
+static Result rewind_benchmark(ProgressBox* pbox, Menu* app, std::vector<RewindBenchmarkResult>& out) {
+    const auto size = app->rewind_buffer_size;
+    const auto frame_count = REWIND_BENCHMARK_SAMPLES * 2 * app->rewind_keyframe_interval;
+
+    // backup everything the benchmark will change.
+    std::vector<u8> backup_state(app->rewind_state_buffer_size);
+    std::vector<u8> backup_pixels(app->pixel_buffer_size);
+    const auto backup_pixel_buffer_index = app->pixel_buffer_index;
+    const auto backup_rewind_counter = app->rewind_counter;
+    const auto backup_rewind_should_push = app->rewind_should_push;
+    R_UNLESS(SMS_savestate(&app->sms, backup_state.data(), backup_state.size(), &app->rewind_state_config), Result_EmuCreateSaveState);
+    std::memcpy(backup_pixels.data(), app->pixel_buffer[app->pixel_buffer_index], backup_pixels.size());
+
+    ON_SCOPE_EXIT(
+        SMS_loadstate(&app->sms, backup_state.data(), backup_state.size(), &app->rewind_state_config);
+        std::memcpy(app->pixel_buffer[0], backup_pixels.data(), backup_pixels.size());
+        std::memcpy(app->pixel_buffer[1], backup_pixels.data(), backup_pixels.size());
+        app->pixel_buffer_index = backup_pixel_buffer_index;
+        app->rewind_counter = backup_rewind_counter;
+        app->rewind_should_push = backup_rewind_should_push;
+        app->pending_frame = true;
+        SMS_set_pixels(&app->sms, app->pixel_buffer[app->pixel_buffer_index ^ 1], SMS_SCREEN_WIDTH, sizeof(u32));
+    );
+
+    pbox->NewTransfer("Capturing frames"_i18n);
+    // the first half trains the dictionary, the second half is measured.
+    std::vector<std::vector<u8>> captured(REWIND_BENCHMARK_SAMPLES * 2);
+    for (size_t i = 0; i < captured.size(); i++) {
+        for (int j = 0; j < app->rewind_keyframe_interval; j++) {
+            R_TRY(pbox->ShouldExitResult());
+            emulator_run(app, SMS_cycles_per_frame(&app->sms), true, false, true);
+            pbox->UpdateTransfer(i * app->rewind_keyframe_interval + j, frame_count);
+        }
+
+        auto& sample = captured[i];
+        sample.resize(size);
+        rewind_frame_encode(sample.data(), (const u32*)app->pixel_buffer[app->pixel_buffer_index], SMS_SCREEN_WIDTH, SMS_SCREEN_HEIGHT);
+        R_UNLESS(SMS_savestate(&app->sms, sample.data() + app->rewind_pixel_buffer_size, app->rewind_state_buffer_size, &app->rewind_state_config), Result_EmuCreateSaveState);
+    }
+
+    const std::span training{captured.data(), REWIND_BENCHMARK_SAMPLES};
+    const std::span samples{captured.data() + REWIND_BENCHMARK_SAMPLES, REWIND_BENCHMARK_SAMPLES};
+
+    // build the dictionary from the states, newest last as lz4 prefers recent data.
+    std::vector<u8> dict;
+    for (const auto& sample : training) {
+        dict.insert(dict.end(), sample.begin() + app->rewind_pixel_buffer_size, sample.end());
+    }
+    if (dict.size() > REWIND_DICT_SIZE) {
+        dict.erase(dict.begin(), dict.end() - REWIND_DICT_SIZE);
+    }
+
+    if (R_FAILED(fs::write_entire_file(REWIND_DICT_PATH, dict))) {
+        log_write("[rewind] failed to save dictionary\n");
+    }
+
+    std::vector<u8> pop_buffer(size);
+    for (int i = 0; i < RewindCodecType_MAX; i++) {
+        R_TRY(pbox->ShouldExitResult());
+
+        const auto type = (RewindCodecType)i;
+        pbox->NewTransfer("Testing "_i18n + rewind_codec_get_name(type));
+
+        RewindCodec codec;
+        rewind_codec_init(&codec, type);
+        codec.dict = dict.data();
+        codec.dict_size = dict.size();
+
+        auto rw = rewind_init(size, samples.size(), rewind_codec_compressor, rewind_codec_compressor_size, &codec);
+        R_UNLESS(rw, Result_EmuCreateSaveState);
+        ON_SCOPE_EXIT(rewind_close(rw));
+
+        RewindBenchmarkResult result{};
+        result.type = type;
+
+        TimeStamp ts;
+        for (size_t j = 0; j < samples.size(); j++) {
+            size_t compressed;
+            R_UNLESS(rewind_push(rw, samples[j].data(), size, &compressed), Result_EmuCreateSaveState);
+            result.uncompressed += size;
+            result.compressed += compressed;
+            pbox->UpdateTransfer(j, samples.size() * 2);
+        }
+        result.push_ms = ts.GetMsD() / samples.size();
+
+        ts.Update();
+        for (size_t j = 0; j < samples.size(); j++) {
+            R_UNLESS(rewind_pop(rw, pop_buffer.data(), size), Result_EmuLoadSaveState);
+            pbox->UpdateTransfer(samples.size() + j, samples.size() * 2);
+        }
+        result.pop_ms = ts.GetMsD() / samples.size();
+
+        log_write("[rewind] benchmark %s: ratio: %.2f%% push: %.2fms pop: %.2fms\n", rewind_codec_get_name(type), (double)result.compressed / (double)result.uncompressed * 100.0, result.push_ms, result.pop_ms);
+        out.emplace_back(result);
+    }
+
+    R_SUCCEED();
+}
+
+// captures audio from the loaded rom, then measures how long it takes to
+// stretch it at every speed. like the rewind benchmark, this runs on the
+// progress box thread whilst the menu is not being updated.
+static Result time_stretch_benchmark(ProgressBox* pbox, Menu* app, std::vector<TimeStretchBenchmarkResult>& out) {
+    const u32 frame_count = TIME_STRETCH_BENCHMARK_SECONDS * SMS_target_fps(&app->sms);
+
+    // backup everything the benchmark will change.
+    std::vector<u8> backup_state(app->rewind_state_buffer_size);
+    const auto backup_rewind_counter = app->rewind_counter;
+    const auto backup_rewind_should_push = app->rewind_should_push;
+    const auto backup_autosave_counter = app->autosave_counter;
+    const auto backup_autosave_should_save = app->autosave_should_save;
+    R_UNLESS(SMS_savestate(&app->sms, backup_state.data(), backup_state.size(), &app->rewind_state_config), Result_EmuCreateSaveState);
+
+    std::vector<int16_t> samples;
+    app->audio_capture = &samples;
+    audio_update_core_buffer(app);
+
+    ON_SCOPE_EXIT(
+        app->audio_capture = nullptr;
+        audio_update_core_buffer(app);
+        SMS_loadstate(&app->sms, backup_state.data(), backup_state.size(), &app->rewind_state_config);
+        app->rewind_counter = backup_rewind_counter;
+        app->rewind_should_push = backup_rewind_should_push;
+        app->autosave_counter = backup_autosave_counter;
+        app->autosave_should_save = backup_autosave_should_save;
+    );
+
+    pbox->NewTransfer("Capturing audio"_i18n);
+    for (u32 i = 0; i < frame_count; i++) {
+        R_TRY(pbox->ShouldExitResult());
+        emulator_run(app, SMS_cycles_per_frame(&app->sms) / SPEED_TABLE[app->speed_index], false, true, true);
+        pbox->UpdateTransfer(i, frame_count);
+    }
+
+    const size_t block_frames = app->sample_block_size / 2;
+    const size_t sample_frames = samples.size() / 2;
+    std::vector<int16_t> output(block_frames * 2);
+
+    for (u32 i = 0; i < std::size(SPEED_TABLE); i++) {
+        if (i == SPEED_DEFAULT_INDEX) {
+            continue;
+        }
+
+        R_TRY(pbox->ShouldExitResult());
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.2fx", SPEED_TABLE[i]);
+        pbox->NewTransfer("Testing "_i18n + buf);
+
+        auto ts = time_stretch_init(SAMPLE_FREQ, block_frames);
+        R_UNLESS(ts, 0x1);
+        ON_SCOPE_EXIT(time_stretch_quit(ts));
+        time_stretch_set_ratio(ts, SPEED_TABLE[i]);
+
+        TimeStamp timestamp;
+        size_t output_frames{};
+        for (size_t off = 0; off < sample_frames; off += block_frames) {
+            const auto count = std::min(block_frames, sample_frames - off);
+            time_stretch_push(ts, samples.data() + off * 2, count);
+            while (const auto frames = time_stretch_pull(ts, output.data(), block_frames)) {
+                output_frames += frames;
+            }
+            pbox->UpdateTransfer(off, sample_frames);
+        }
+
+        TimeStretchBenchmarkResult result{};
+        result.speed = SPEED_TABLE[i];
+        // the time budget is one frame per 1x frame of output.
+        const double output_frame_count = (double)output_frames / SAMPLE_FREQ * SMS_target_fps(&app->sms);
+        result.ms_per_frame = output_frame_count ? timestamp.GetMsD() / output_frame_count : 0;
+
+        log_write("[audio] time stretch benchmark %.2fx: %.3fms per frame\n", result.speed, result.ms_per_frame);
+        out.emplace_back(result);
+    }
+
+    R_SUCCEED();
+}
+
 } // namespace
 
 Menu::Menu(const fs::FsPath& rom_path, bool close_on_exit) : m_rom_path{rom_path}, m_close_on_exit{close_on_exit} {
@@ -809,6 +1678,16 @@ Menu::Menu(const fs::FsPath& rom_path, bool close_on_exit) : m_rom_path{rom_path
             else if (app->m_runahead_lazy.LoadFrom(Key, Value)) {}
             else if (app->m_savestate_on_exit.LoadFrom(Key, Value)) {}
             else if (app->m_loadstate_on_start.LoadFrom(Key, Value)) {}
+            else if (app->m_autosave.LoadFrom(Key, Value)) {}
+            else if (app->m_rewind_codec.LoadFrom(Key, Value)) {}
+            else if (app->m_rewind_disk.LoadFrom(Key, Value)) {}
+            else if (app->m_rewind_disk_resume.LoadFrom(Key, Value)) {}
+            else if (app->m_rewind_stats.LoadFrom(Key, Value)) {}
+            else if (app->m_sync.LoadFrom(Key, Value)) {}
+            else if (app->m_time_stretch.LoadFrom(Key, Value)) {}
+            else if (app->m_audio_latency.LoadFrom(Key, Value)) {}
+            else if (app->m_audio_stats.LoadFrom(Key, Value)) {}
+            else if (app->m_audio_backend.LoadFrom(Key, Value)) {}
         }
 
         return 1;
@@ -840,7 +1719,8 @@ Menu::Menu(const fs::FsPath& rom_path, bool close_on_exit) : m_rom_path{rom_path
     app->pixel_buffer_size = sizeof(u32) * SMS_SCREEN_WIDTH * SMS_SCREEN_HEIGHT;
     app->pixel_buffer[0] = calloc(1, app->pixel_buffer_size);
     app->pixel_buffer[1] = calloc(1, app->pixel_buffer_size);
-    if (!app->pixel_buffer[0] || !app->pixel_buffer[1]) {
+    app->rewind_frame_buffer = calloc(1, app->pixel_buffer_size);
+    if (!app->pixel_buffer[0] || !app->pixel_buffer[1] || !app->rewind_frame_buffer) {
         SetPop();
         return;
     }
@@ -850,7 +1730,12 @@ Menu::Menu(const fs::FsPath& rom_path, bool close_on_exit) : m_rom_path{rom_path
         return;
     }
 
-    if (R_FAILED(audio_init(app))) {
+    if (R_FAILED(savestate_writer.Init())) {
+        log_write("[savestate] failed to create writer, writing on the main thread\n");
+    }
+
+    audio_out = audio_create_sink(app);
+    if (!audio_out) {
         log_write("failed audio init\n");
         SetPop();
         return;
@@ -858,11 +1743,15 @@ Menu::Menu(const fs::FsPath& rom_path, bool close_on_exit) : m_rom_path{rom_path
 
     const size_t sample_data_size = SAMPLE_COUNT;
     app->sample_data = (int16_t*)malloc(sample_data_size * sizeof(*app->sample_data));
-    if (!app->sample_data) {
+    app->time_stretch_buffer = (int16_t*)malloc(sample_data_size * sizeof(*app->time_stretch_buffer));
+    if (!app->sample_data || !app->time_stretch_buffer) {
         SetPop();
         return;
     }
 
+    // audio is played at 1x speed if this fails.
+    app->time_stretch = time_stretch_init(SAMPLE_FREQ, sample_data_size / 2);
+
     generate_palette(app, sms_converted_palette, SMS_BPP);
     generate_palette(app, gg_converted_palette, GG_BPP);
     generate_sg_palette(app, sg_converted_palette);
@@ -871,7 +1760,7 @@ Menu::Menu(const fs::FsPath& rom_path, bool close_on_exit) : m_rom_path{rom_path
     SMS_set_userdata(&app->sms, app);
     SMS_set_colour_callback(&app->sms, core_colour_callback);
     SMS_set_vblank_callback(&app->sms, core_vblank_callback);
-    SMS_set_apu_callback(&app->sms, core_audio_callback, app->sample_data, sample_data_size, SAMPLE_FREQ);
+    on_audio_change(app);
     SMS_set_input_callback(&app->sms, core_input_callback);
     SMS_set_pixels(&app->sms, app->pixel_buffer[app->pixel_buffer_index ^ 1], SMS_SCREEN_WIDTH, sizeof(u32));
     SMS_set_builtin_palette(&app->sms, sg_converted_palette);
@@ -898,7 +1787,7 @@ Menu::Menu(const fs::FsPath& rom_path, bool close_on_exit) : m_rom_path{rom_path
     }
 
     if (m_loadstate_on_start.Get()) {
-        mgb_load_state_file(NULL);
+        savestate_load(app, 0);
     }
 
     runahead_init(app, m_runahead.Get());
@@ -910,46 +1799,63 @@ Menu::Menu(const fs::FsPath& rom_path, bool close_on_exit) : m_rom_path{rom_path
 Menu::~Menu() {
     auto app = this;
 
-    audoutStopAudioOut();
-    audoutExit();
+    if (audio_out) {
+        audio_log_stats(app);
+        audio_out.reset();
+    }
 
     if (mgb_has_rom()) {
         if (m_savestate_on_exit.Get()) {
-            mgb_save_state_file(NULL);
+            savestate_create(app, 0);
         }
+
+        sram_flush(app, true);
     }
 
+    // waits for pending savestates and battery saves to be written.
+    savestate_writer.Exit();
+
     runahead_exit(app);
     mgb_exit();
     SMS_quit(&app->sms);
 
     DestroyTextures();
 
+    rewind_exit(app);
+
     #if 0
     stbi_write_png("/background_256x192.png", SMS_SCREEN_WIDTH, SMS_SCREEN_HEIGHT, 4, app->pixel_buffer[app->pixel_buffer_index], SMS_SCREEN_WIDTH * 4);
     #endif
 
-    if (app->rewind) {
-        rewind_close(app->rewind);
-    }
     if (app->rewind_buffer) {
         free(app->rewind_buffer);
     }
     if (app->sample_data) {
         free(app->sample_data);
     }
+    if (app->time_stretch_buffer) {
+        free(app->time_stretch_buffer);
+    }
+    time_stretch_quit(app->time_stretch);
     if (app->pixel_buffer[0]) {
         free(app->pixel_buffer[0]);
     }
     if (app->pixel_buffer[1]) {
         free(app->pixel_buffer[1]);
     }
+    if (app->rewind_frame_buffer) {
+        free(app->rewind_frame_buffer);
+    }
 }
 
 void Menu::Update(Controller* controller, TouchInfo* touch) {
     Widget::Update(controller, touch);
     auto app = this;
 
+    if (savestate_writer.PopFailedCount()) {
+        App::Notify("Failed to save state");
+    }
+
     static TimeStamp pause_ts;
     static bool pending_pause{};
 
@@ -987,17 +1893,29 @@ void Menu::Update(Controller* controller, TouchInfo* touch) {
     const double delta = (double)(now - start) / (double)(1e+9);
     // const double delta = 1.0 / 60.0;// (double)(now - start) / (double)(1e+9);
     start = now;
+    audio_update_frame_time(app, delta);
 
     on_update_sound_playback_state(app);
 
     if (should_emu_run(app)) {
-        const double TARGET_FRAME_TIME = 1.0 / SMS_target_fps(&app->sms);
-        runahead_run_frame(app, delta / TARGET_FRAME_TIME);
+        if (audio_sync_is_enabled(app)) {
+            audio_sync_run(app);
+        } else {
+            const double TARGET_FRAME_TIME = 1.0 / SMS_target_fps(&app->sms);
+            runahead_run_frame(app, delta / TARGET_FRAME_TIME);
+        }
 
         if (app->rewind_should_push) {
             rewind_push_new_frame(app);
             app->rewind_should_push = false;
         }
+
+        if (app->autosave_should_save) {
+            autosave_create(app);
+            autosave_reset(app);
+        }
+
+        sram_flush(app, false);
     } else if (rewind_bar_enabled()) {
         if (controller->GotDown(Button::ANY_LEFT)) {
             rewind_bar_button(this, RewindBarButton_Left);
@@ -1028,8 +1946,12 @@ void Menu::Draw(NVGcontext* vg, Theme* theme) {
     emulator_render(app);
     rewind_bar_render(vg, theme, app);
 
-    for (auto& e : m_rewind_bar_textures.textures) {
-        e.used = false;
+    if (app->m_rewind_stats.Get()) {
+        rewind_stats_render(vg, app);
+    }
+
+    if (app->m_audio_stats.Get()) {
+        audio_stats_render(vg, app);
     }
 }
 
@@ -1041,6 +1963,7 @@ void Menu::OnFocusGained() {
 void Menu::OnFocusLost() {
     Widget::OnFocusLost();
     focus = false;
+    sram_flush(this, true);
 }
 
 void Menu::emulator_update_texture_pixels(Menu* app, int handle, const void* pixel_buffer) {
@@ -1051,25 +1974,31 @@ void Menu::emulator_update_texture_pixels(Menu* app, int handle, const void* pix
 }
 
 bool Menu::rewind_push_new_frame(Menu* app) {
-    memcpy(app->rewind_pixel_buffer, app->pixel_buffer[app->pixel_buffer_index], app->pixel_buffer_size);
-
-    if (!SMS_savestate(&app->sms, app->rewind_state_buffer, app->rewind_state_buffer_size, &app->rewind_state_config)) {
+    if (!app->rewind) {
         return false;
     }
 
-    size_t compressed_size;
-    if (!rewind_push(app->rewind, app->rewind_buffer, app->rewind_buffer_size, &compressed_size)) {
-        return false;
+    // copy the snapshot into a free slot, compression is done on the worker thread.
+    if (app->rewind_worker.IsRunning()) {
+        auto slot = (u8*)app->rewind_worker.Acquire();
+        rewind_frame_encode(slot, (const u32*)app->pixel_buffer[app->pixel_buffer_index], SMS_SCREEN_WIDTH, SMS_SCREEN_HEIGHT);
+
+        if (!SMS_savestate(&app->sms, slot + app->rewind_pixel_buffer_size, app->rewind_state_buffer_size, &app->rewind_state_config)) {
+            return false;
+        }
+
+        app->rewind_worker.Submit();
+        return true;
     }
 
-    // enable to see compression ratio.
-#if 0
-    const size_t count = rewind_get_count(app->rewind);
-    const double total = rewind_get_allocated_size(app->rewind, false);
-    log_write("old_size: %.2f KiB new_size: %.2f KiB compression %.2f%% count: %zu total: %.2f MiB avg: %.2f KiB\n", app->rewind_buffer_size / 1024.0, compressed_size / 1024.0, ((double)compressed_size / (double)app->rewind_buffer_size) * 100.0, count, total / 1024.0 / 1024.0, total / (double)count / 1024.0);
-#endif
+    rewind_frame_encode(app->rewind_pixel_buffer, (const u32*)app->pixel_buffer[app->pixel_buffer_index], SMS_SCREEN_WIDTH, SMS_SCREEN_HEIGHT);
 
-    return true;
+    if (!SMS_savestate(&app->sms, app->rewind_state_buffer, app->rewind_state_buffer_size, &app->rewind_state_config)) {
+        return false;
+    }
+
+    // see rewind_log_stats() for the compression ratio.
+    return rewind_push(app->rewind, app->rewind_buffer, app->rewind_buffer_size, NULL);
 }
 
 bool Menu::CreateTextures() {
@@ -1094,6 +2023,7 @@ bool Menu::CreateTextures() {
             return false;
         }
     }
+    m_rewind_bar_textures.Clear();
 
     // log_write("CreateTextures(), time taken: %.2fs %zums\n", ts.GetSecondsD(), ts.GetMs());
 
@@ -1265,71 +2195,227 @@ void Menu::DisplayOptions() {
 
             options->Add<SidebarEntryBool>("Load savestate on start"_i18n, m_loadstate_on_start);
 
+            SidebarEntryArray::Items autosave_items;
+            for (auto& e : CONFIG_AUTOSAVE) {
+                autosave_items.emplace_back(i18n::get(e.name));
+            }
+
+            options->Add<SidebarEntryArray>("Auto savestate"_i18n, autosave_items, [this](s64& index_out){
+                m_autosave.Set(index_out);
+                autosave_reset(this);
+            }, m_autosave.Get(),
+                "Creates a savestate in the background at the set interval of play time.\n\n"\
+                "The last 3 auto savestates are kept and can be loaded from \"Load Savestate\"."_i18n
+            );
+
+            SidebarEntryArray::Items sync_items;
+            for (auto& e : CONFIG_SYNC) {
+                sync_items.emplace_back(i18n::get(e.name));
+            }
+
+            options->Add<SidebarEntryArray>("Sync"_i18n, sync_items, [this](s64& index_out){
+                m_sync.Set(index_out);
+                on_audio_change(this);
+            }, m_sync.Get(),
+                "[Video]: Runs at the frame rate, audio may crackle if a frame is late.\n"\
+                "[Audio]: Runs only when audio is needed, so audio never drops out but frames may be skipped or repeated.\n\n"\
+                "Audio sync is only used at 1x speed with runahead disabled."_i18n
+            );
+
+            SidebarEntryArray::Items audio_latency_items;
+            for (auto& e : CONFIG_AUDIO_LATENCY) {
+                audio_latency_items.emplace_back(i18n::get(e.name));
+            }
+
+            options->Add<SidebarEntryArray>("Audio latency"_i18n, audio_latency_items, [this](s64& index_out){
+                m_audio_latency.Set(index_out);
+                on_audio_change(this);
+            }, m_audio_latency.Get(),
+                "The amount of audio to keep queued. Lower values reduce the delay of sound effects.\n\n"\
+                "If audio crackles, the queue grows until it stops, then slowly shrinks back to the target."_i18n
+            );
+
+            SidebarEntryArray::Items audio_backend_items;
+            for (auto& e : CONFIG_AUDIO_BACKEND) {
+                audio_backend_items.emplace_back(i18n::get(e.name));
+            }
+
+            options->Add<SidebarEntryArray>("Audio output"_i18n, audio_backend_items, [this](s64& index_out){
+                m_audio_backend.Set(index_out);
+                on_audio_backend_change(this);
+            }, m_audio_backend.Get(),
+                "[Audout]: Plays audio.\n"\
+                "[Null]: Discards audio.\n"\
+                "[WAV]: Writes audio to /switch/TotalSMS/audio/<rom>.wav instead of playing it.\n\n"\
+                "Audio sync is only used with Audout."_i18n
+            );
+
+            options->Add<SidebarEntryBool>(
+                "Show audio stats"_i18n, m_audio_stats,
+                "Shows audio underruns, dropped blocks, queue depth, latency and frame time. These are also written to the log when exiting."_i18n
+            );
+
+            options->Add<SidebarEntryBool>("Time stretch audio"_i18n, m_time_stretch, [this](bool& v_out){
+                time_stretch_apply(this);
+            },
+                "Keeps the pitch of the audio the same when not running at 1x speed."_i18n
+            );
+
+            options->Add<SidebarEntryCallback>("Benchmark time stretch"_i18n, [this](){
+                auto results = std::make_shared<std::vector<TimeStretchBenchmarkResult>>();
+
+                App::Push<ProgressBox>(0, "Benchmark"_i18n, "Time stretch"_i18n, [this, results](auto pbox){
+                    return time_stretch_benchmark(pbox, this, *results);
+                }, [results](Result rc){
+                    if (R_FAILED(rc)) {
+                        App::PushErrorBox(rc, "Time stretch benchmark failed"_i18n);
+                        return;
+                    }
+
+                    std::string msg = "Time per frame\n\n"_i18n;
+                    for (const auto& e : *results) {
+                        char buf[128];
+                        std::snprintf(buf, sizeof(buf), "%.2fx: %.3fms\n", e.speed, e.ms_per_frame);
+                        msg += buf;
+                    }
+
+                    App::Push<OptionBox>(msg, "OK"_i18n);
+                });
+            }, "Measures how long it takes to time stretch the audio of the current game at each speed."_i18n);
+
             options->Add<SidebarEntryBool>(
                 "Skip splash screen intro"_i18n, App::GetApp()->m_skip_splash_screen_intro,
                 "Skips the Sega intro when launching the app, loading straight into the filebrowser if enabled."_i18n
             );
+
+            options->Add<SidebarEntryBool>(
+                "Rewind SD history"_i18n, m_rewind_disk,
+                "Moves rewind frames that no longer fit in memory to the SD card, allowing for hours of rewind.\n\n"\
+                "Takes effect the next time a game is loaded."_i18n
+            );
+
+            options->Add<SidebarEntryBool>(
+                "Resume rewind history"_i18n, m_rewind_disk_resume,
+                "Keeps the rewind SD history when exiting, so that it can be rewound to the next time the game is loaded.\n\n"\
+                "Requires \"Rewind SD history\" to be enabled."_i18n
+            );
+
+            SidebarEntryArray::Items rewind_codec_items;
+            for (auto& e : CONFIG_REWIND_CODEC) {
+                rewind_codec_items.emplace_back(i18n::get(e.name));
+            }
+
+            options->Add<SidebarEntryArray>("Rewind compression"_i18n, rewind_codec_items, [this](s64& index_out){
+                m_rewind_codec.Set(index_out);
+                rewind_apply_codec(this);
+            }, m_rewind_codec.Get(),
+                "[Auto]: Measures each codec and picks the smallest that fits the time budget.\n"\
+                "[LZ4]: Default LZ4.\n"\
+                "[LZ4 Fast]: Faster but larger than LZ4.\n"\
+                "[LZ4HC]: Slower but smaller than LZ4.\n"\
+                "[LZ4 Dictionary]: LZ4 using a dictionary created by the rewind benchmark."_i18n
+            );
+
+            options->Add<SidebarEntryBool>(
+                "Show rewind stats"_i18n, m_rewind_stats,
+                "Shows the rewind memory usage, compression ratio and timings. These are also written to the log when the rewind bar is opened."_i18n
+            );
+
+            options->Add<SidebarEntryCallback>("Benchmark rewind compression"_i18n, [this](){
+                auto results = std::make_shared<std::vector<RewindBenchmarkResult>>();
+
+                App::Push<ProgressBox>(0, "Benchmark"_i18n, "Rewind compression"_i18n, [this, results](auto pbox){
+                    return rewind_benchmark(pbox, this, *results);
+                }, [results](Result rc){
+                    if (R_FAILED(rc)) {
+                        App::PushErrorBox(rc, "Rewind benchmark failed"_i18n);
+                        return;
+                    }
+
+                    std::string msg = "Ratio / push / pop per frame\n\n"_i18n;
+                    for (const auto& e : *results) {
+                        char buf[128];
+                        std::snprintf(buf, sizeof(buf), "%s: %.2f%% / %.2fms / %.2fms\n", rewind_codec_get_name(e.type), (double)e.compressed / (double)e.uncompressed * 100.0, e.push_ms, e.pop_ms);
+                        msg += buf;
+                    }
+
+                    App::Push<OptionBox>(msg, "OK"_i18n);
+                });
+            }, "Measures the compression ratio and speed of each rewind codec using the current game.\n\n"\
+               "This also creates the dictionary used by LZ4 Dictionary, which is loaded the next time a game is started. "\
+               "Rewind history saved to the sd card with the previous dictionary is then discarded."_i18n);
         });
 
     }, "Change the emulator options."_i18n);
 
     options->Add<SidebarEntryCallback>("Load Savestate"_i18n, [this](){
-        auto info = mgb_load_state_info_file(NULL, true);
-        if (!info) {
+        savestate_index_add_legacy(this);
+
+        auto options = std::make_unique<Sidebar>("Load Savestate"_i18n, Sidebar::Side::LEFT);
+        bool has_slot{};
+
+        for (u32 i = 0; i < SaveStateIndex::SLOT_COUNT; i++) {
+            const auto& slot = savestate_index.Get(i);
+            if (!slot.used) {
+                continue;
+            }
+
+            has_slot = true;
+            options->Add<SidebarEntryCallback>(savestate_get_title(slot, i), [this, i](){
+                const auto& slot = savestate_index.Get(i);
+
+                App::Push<ui::OptionBox>(
+                    "Load savestate?\n\n"_i18n + savestate_get_title(slot, i), "No"_i18n, "Yes"_i18n, 1, [this, i](auto op_index){
+                        if (op_index && *op_index) {
+                            if (!savestate_load(this, i)) {
+                                App::PushErrorBox(Result_EmuLoadSaveState, "Failed to load savestate");
+                            } else {
+                                App::PopToMenu();
+                            }
+                        }
+                    }, savestate_create_image(slot), true
+                );
+            });
+        }
+
+        if (!has_slot) {
             App::PushErrorBox(Result_EmuLoadSaveState, "Failed to load savestate");
             return;
         }
-        ON_SCOPE_EXIT(mgb_free_state_info(info));
 
-        const time_t timestamp = info->meta.timestamp;
-        const struct tm* tm = localtime(&timestamp);
-        char buf[256];
-        std::snprintf(buf, sizeof(buf), "Load savestate?\n\n%02u/%02u/%04u - %02u:%02u:%02u", tm->tm_mday, tm->tm_mon + 1, tm->tm_year + 1900, tm->tm_hour, tm->tm_min, tm->tm_sec);
-
-        const auto image = nvgCreateImageMem(App::GetVg(), 0, info->png, info->png_size);
-
-        App::Push<ui::OptionBox>(
-            buf, "No"_i18n, "Yes"_i18n, 1, [this](auto op_index){
-                if (op_index && *op_index) {
-                    if (!mgb_load_state_file(NULL)) {
-                        App::PushErrorBox(Result_EmuLoadSaveState, "Failed to load savestate");
-                    } else {
-                        App::PopToMenu();
-                    }
-                }
-            }, image, true
-        );
+        App::Push(std::move(options));
     }, "Loads a savestate."_i18n);
 
     options->Add<SidebarEntryCallback>("Create Savestate"_i18n, [this](){
-        const auto func = [this](){
-            if (!mgb_save_state_file(NULL)) {
-                App::PushErrorBox(Result_EmuCreateSaveState, "Failed to create savestate");
-            } else {
-                App::PopToMenu();
-            }
-        };
+        savestate_index_add_legacy(this);
 
-        auto info = mgb_load_state_info_file(NULL, true);
-        if (info) {
-            ON_SCOPE_EXIT(mgb_free_state_info(info));
+        auto options = std::make_unique<Sidebar>("Create Savestate"_i18n, Sidebar::Side::LEFT);
+        ON_SCOPE_EXIT(App::Push(std::move(options)));
 
-            const time_t timestamp = info->meta.timestamp;
-            const struct tm* tm = localtime(&timestamp);
-            char buf[256];
-            std::snprintf(buf, sizeof(buf), "Overwrite savestate?\n\n%02u/%02u/%04u - %02u:%02u:%02u", tm->tm_mday, tm->tm_mon + 1, tm->tm_year + 1900, tm->tm_hour, tm->tm_min, tm->tm_sec);
+        for (u32 i = 0; i < SaveStateIndex::USER_SLOT_COUNT; i++) {
+            options->Add<SidebarEntryCallback>(savestate_get_title(savestate_index.Get(i), i), [this, i](){
+                const auto func = [this, i](){
+                    if (!savestate_create(this, i)) {
+                        App::PushErrorBox(Result_EmuCreateSaveState, "Failed to create savestate");
+                    } else {
+                        App::PopToMenu();
+                    }
+                };
 
-            const auto image = nvgCreateImageMem(App::GetVg(), 0, info->png, info->png_size);
+                const auto& slot = savestate_index.Get(i);
+                if (!slot.used) {
+                    func();
+                    return;
+                }
 
-            App::Push<ui::OptionBox>(
-                buf, "No"_i18n, "Yes"_i18n, 1, [this, func](auto op_index){
-                    if (op_index && *op_index) {
-                        func();
-                    }
-                }, image, true
-            );
-        } else {
-            func();
+                App::Push<ui::OptionBox>(
+                    "Overwrite savestate?\n\n"_i18n + savestate_get_title(slot, i), "No"_i18n, "Yes"_i18n, 1, [func](auto op_index){
+                        if (op_index && *op_index) {
+                            func();
+                        }
+                    }, savestate_create_image(slot), true
+                );
+            });
         }
     }, "Creates a savestate."_i18n);
 
@@ -1338,6 +2424,8 @@ void Menu::DisplayOptions() {
             "Reset Game?"_i18n,
             "No"_i18n, "Yes"_i18n, 1, [this](auto op_index){
                 if (op_index && *op_index) {
+                    // mgb writes the save before reloading, don't let a pending write replace it.
+                    savestate_writer.Flush();
                     mgb_load_rom_file(m_rom_path);
                     App::PopToMenu();
                 }
@@ -17,6 +17,7 @@
 #include "i18n.hpp"
 #include "threaded_file_transfer.hpp"
 #include "minizip_helper.hpp"
+#include "reserve_grow.hpp"
 
 #include <minIni.h>
 #include <minizip/zip.h>
@@ -30,6 +31,8 @@
 #include <span>
 #include <utility>
 #include <ranges>
+#include <algorithm>
+#include <array>
 
 namespace sphaira::ui::menu::filebrowser {
 namespace {
@@ -59,6 +62,17 @@ constexpr std::string_view FILTER_EXTENSIONS[] = {
     "sms", "gg", "bin", "sg", "zip"
 };
 
+// rows above and below the visible ones that metadata is loaded for.
+constexpr s64 META_PREFETCH_ROWS = 8;
+
+// whilst scanning, the list is sorted at most this often rather than after every chunk.
+constexpr u64 SCAN_SORT_INTERVAL_MS = 250;
+
+// library names added to the search index per frame.
+constexpr size_t LIBRARY_INDEX_PER_FRAME = 2048;
+// the popup list is not meant for huge lists.
+constexpr size_t LIBRARY_SEARCH_MAX_RESULTS = 500;
+
 auto IsExtension(std::string_view ext, std::span<const std::string_view> list) -> bool {
     for (auto e : list) {
         if (e.length() == ext.length() && !strncasecmp(ext.data(), e.data(), ext.length())) {
@@ -72,8 +86,163 @@ auto IsExtension(std::string_view ext1, std::string_view ext2) -> bool {
     return ext1.length() == ext2.length() && !strncasecmp(ext1.data(), ext2.data(), ext1.length());
 }
 
+// smaller lists are sorted with std::sort, radix sort only wins once the
+// passes over the list cost less than the comparisons.
+constexpr size_t RADIX_SORT_MIN = 256;
+
+// lower case, big endian, so that the keys compare the same as strcasecmp().
+auto MakeNameKey(std::string_view name) -> u64 {
+    u64 key{};
+    for (size_t i = 0; i < sizeof(key); i++) {
+        key <<= 8;
+        if (i < name.length()) {
+            key |= (u8)std::tolower((unsigned char)name[i]);
+        }
+    }
+    return key;
+}
+
+// stable lsd radix sort of the indices by their key, a byte per pass.
+// bytes that are the same in every key are skipped, so sorting by size only
+// takes a few passes.
+template <typename KeyFunc>
+void RadixSort(std::span<u32> indices, KeyFunc get_key) {
+    const auto count = indices.size();
+    std::vector<u32> idx(indices.begin(), indices.end()), idx_tmp(count);
+    std::vector<u64> keys(count), keys_tmp(count);
+
+    u64 diff{};
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = get_key(idx[i]);
+        diff |= keys[i] ^ keys[0];
+    }
+
+    for (u32 shift = 0; shift < 64; shift += 8) {
+        if (!((diff >> shift) & 0xFF)) {
+            continue;
+        }
+
+        std::array<u32, 257> offsets{};
+        for (const auto key : keys) {
+            offsets[((key >> shift) & 0xFF) + 1]++;
+        }
+        for (size_t i = 1; i < offsets.size(); i++) {
+            offsets[i] += offsets[i - 1];
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            const auto pos = offsets[(keys[i] >> shift) & 0xFF]++;
+            idx_tmp[pos] = idx[i];
+            keys_tmp[pos] = keys[i];
+        }
+
+        std::swap(idx, idx_tmp);
+        std::swap(keys, keys_tmp);
+    }
+
+    std::copy(idx.begin(), idx.end(), indices.begin());
+}
+
+// calls func on each run of neighbouring indices that pred says are equal.
+template <typename Pred, typename Func>
+void ForEachRun(std::span<u32> indices, Pred pred, Func func) {
+    for (size_t start = 0; start < indices.size();) {
+        size_t end = start + 1;
+        while (end < indices.size() && pred(indices[start], indices[end])) {
+            end++;
+        }
+        if (end - start > 1) {
+            func(indices.subspan(start, end - start));
+        }
+        start = end;
+    }
+}
+
+auto GetNameExtension(std::string_view name) -> std::string_view {
+    const auto dot = name.find_last_of('.');
+    if (dot == name.npos) {
+        return {};
+    }
+    return name.substr(dot + 1);
+}
+
 } // namespace
 
+void FileEntries::Clear() {
+    // the memory is released, a huge folder should not keep its names around.
+    *this = {};
+}
+
+void FileEntries::Reserve(size_t count, size_t names_size) {
+    ReserveGrow(m_names, m_names.size() + names_size);
+    ReserveGrow(m_name_offset, count);
+    ReserveGrow(m_name_key, count);
+    ReserveGrow(m_internal_offset, count);
+    ReserveGrow(m_file_size, count);
+    ReserveGrow(m_modified, count);
+    ReserveGrow(m_file_count, count);
+    ReserveGrow(m_dir_count, count);
+    ReserveGrow(m_flags, count);
+}
+
+auto FileEntries::Add(std::string_view name, bool is_dir, s64 file_size) -> u32 {
+    const u32 i = m_flags.size();
+
+    u8 flags{};
+    if (is_dir) {
+        flags |= FileEntryFlag_Dir;
+    }
+    if (name.starts_with('.')) {
+        flags |= FileEntryFlag_Hidden;
+    }
+
+    m_name_offset.emplace_back(AddName(name));
+    m_name_key.emplace_back(MakeNameKey(name));
+    m_internal_offset.emplace_back(NO_NAME);
+    m_file_size.emplace_back(file_size);
+    m_modified.emplace_back(0);
+    m_file_count.emplace_back(-1);
+    m_dir_count.emplace_back(-1);
+    m_flags.emplace_back(flags);
+    return i;
+}
+
+auto FileEntries::GetExtension(u32 i) const -> std::string_view {
+    if (IsDir(i)) {
+        return {};
+    }
+    return GetNameExtension(GetName(i));
+}
+
+auto FileEntries::GetInternalName(u32 i) const -> const char* {
+    if (HasInternalName(i)) {
+        return m_names.data() + m_internal_offset[i];
+    }
+    return GetName(i);
+}
+
+auto FileEntries::GetInternalExtension(u32 i) const -> std::string_view {
+    if (HasInternalName(i)) {
+        return GetNameExtension(GetInternalName(i));
+    }
+    return GetExtension(i);
+}
+
+void FileEntries::SetInternalName(u32 i, std::string_view name) {
+    // the name is only used for its extension.
+    if (GetNameExtension(name).empty()) {
+        return;
+    }
+    m_internal_offset[i] = AddName(name);
+}
+
+auto FileEntries::AddName(std::string_view name) -> u32 {
+    const u32 offset = m_names.size();
+    m_names.insert(m_names.end(), name.begin(), name.end());
+    m_names.emplace_back('\0');
+    return offset;
+}
+
 void SignalChange() {
     ueventSignal(&g_change_uevent);
 }
@@ -85,12 +254,17 @@ FsView::FsView(Menu* menu, const fs::FsPath& path, const FsEntry& entry, ViewSid
                 return;
             }
 
-            const auto& entry = GetEntry();
+            const auto entry = GetEntry();
 
-            if (entry.type == FsDirEntryType_Dir) {
+            if (m_entries.IsDir(entry)) {
                 Scan(GetNewPathCurrent());
             } else {
-                if (IsExtension(entry.GetInternalExtension(), ROM_EXTENSIONS)) {
+                // the zip may be opened before the loader got to it.
+                if (NeedsInternalName(entry)) {
+                    ApplyMeta(DirMetaLoader::Load(m_fs.get(), {entry, false, GetEntryPath(entry), false, true}));
+                }
+
+                if (IsExtension(m_entries.GetInternalExtension(entry), ROM_EXTENSIONS)) {
                     App::Push<menu::emu::Menu>(GetNewPathCurrent());
                 }
             }
@@ -102,6 +276,11 @@ FsView::FsView(Menu* menu, const fs::FsPath& path, const FsEntry& entry, ViewSid
                 return;
             }
 
+            if (IsSearching()) {
+                ClearSearch();
+                return;
+            }
+
             std::string_view view{m_path};
             if (view != m_fs->Root()) {
                 const auto end = view.find_last_of('/');
@@ -119,6 +298,17 @@ FsView::FsView(Menu* menu, const fs::FsPath& path, const FsEntry& entry, ViewSid
             }
         }}),
 
+        std::make_pair(Button::X, Action{"Options"_i18n, [this](){
+            DisplayOptions();
+        }}),
+
+        std::make_pair(Button::Y, Action{"Search"_i18n, [this](){
+            std::string out;
+            if (R_SUCCEEDED(swkbd::ShowText(out, "Search"_i18n.c_str(), m_search_query.c_str()))) {
+                Search(out);
+            }
+        }}),
+
         std::make_pair(Button::START, Action{"Exit"_i18n, [this](){
             App::Exit();
         }})
@@ -126,6 +316,18 @@ FsView::FsView(Menu* menu, const fs::FsPath& path, const FsEntry& entry, ViewSid
 
     SetSide(m_side);
 
+    if (R_FAILED(m_scanner.Init())) {
+        log_write("failed to create scan thread, scanning on the main thread\n");
+    }
+
+    if (R_FAILED(m_meta_loader.Init())) {
+        log_write("failed to create meta thread, loading on the main thread\n");
+    }
+
+    if (R_FAILED(m_preview_cache.Init())) {
+        log_write("failed to create savestate preview thread\n");
+    }
+
     auto buf = path;
     if (path.empty()) {
         ini_gets("paths", "last_path", entry.root, buf, sizeof(buf), App::CONFIG_PATH);
@@ -139,23 +341,38 @@ FsView::FsView(Menu* menu, ViewSide side) : FsView{menu, "", FS_ENTRY_DEFAULT, s
 }
 
 FsView::~FsView() {
+    SaveDirCache();
+    if (m_scanner.IsScanning()) {
+        App::SetBoostMode(false);
+    }
+    m_scanner.Exit();
+    m_meta_loader.Exit();
+    m_preview_cache.Exit();
+    if (m_preview_image) {
+        nvgDeleteImage(App::GetVg(), m_preview_image);
+    }
+
     // don't store mount points for non-sd card paths.
     if (IsSd()) {
         ini_puts("paths", "last_path", m_path, App::CONFIG_PATH);
 
         // save last selected file.
         if (!m_entries.empty()) {
-            ini_puts("paths", "last_file", GetEntry().name, App::CONFIG_PATH);
+            ini_puts("paths", "last_file", GetEntryName(), App::CONFIG_PATH);
         }
     }
 }
 
 void FsView::Update(Controller* controller, TouchInfo* touch) {
+    UpdateScan();
+    ON_SCOPE_EXIT(UpdateMeta());
+
     m_list->OnUpdate(controller, touch, m_index, m_entries_current.size(), [this](bool touch, auto i) {
         if (touch && m_index == i) {
             FireAction(Button::A);
         } else {
             App::PlaySoundEffect(SoundEffect_Focus);
+            m_scan_last_file.reset();
             SetIndex(i);
         }
     });
@@ -165,32 +382,40 @@ void FsView::Draw(NVGcontext* vg, Theme* theme) {
     const auto& text_col = theme->GetColour(ThemeEntryID_TEXT);
 
     if (m_entries_current.empty()) {
-        gfx::drawTextArgs(vg, GetX() + GetW() / 2.f, GetY() + GetH() / 2.f, 36.f, NVG_ALIGN_CENTER | NVG_ALIGN_MIDDLE, theme->GetColour(ThemeEntryID_TEXT_INFO), "Empty..."_i18n.c_str());
+        const auto& text = m_scanner.IsScanning() ? "Scanning..."_i18n : IsSearching() ? "No results..."_i18n : "Empty..."_i18n;
+        gfx::drawTextArgs(vg, GetX() + GetW() / 2.f, GetY() + GetH() / 2.f, 36.f, NVG_ALIGN_CENTER | NVG_ALIGN_MIDDLE, theme->GetColour(ThemeEntryID_TEXT_INFO), text.c_str());
         return;
     }
 
     constexpr float text_xoffset{15.f};
-    bool got_dir_count = false;
 
-    m_list->Draw(vg, theme, m_entries_current.size(), [this, text_col, &got_dir_count](auto* vg, auto* theme, auto v, auto i) {
-        const auto& [x, y, w, h] = v;
-        auto& e = GetEntry(i);
-
-        if (e.IsDir()) {
-            // NOTE: make this native only if hdd dir scan is too slow.
-            // if (m_fs->IsNative() && e.file_count == -1 && e.dir_count == -1) {
-            // NOTE: this takes longer than 16ms when opening a new folder due to it
-            // checking all 9 folders at once.
-            if (!got_dir_count && e.file_count == -1 && e.dir_count == -1) {
-                got_dir_count = true;
-                m_fs->DirGetEntryCount(GetNewPath(e), &e.file_count, &e.dir_count);
-            }
-        } else if (!e.checked_extension) {
-            e.checked_extension = true;
-            if (auto ext = std::strrchr(e.name, '.')) {
-                e.extension = ext+1;
-            }
+    // only the highlighted rom is requested, the cache loads it in the background.
+    std::shared_ptr<const SaveStatePreview> preview{};
+    const auto selected_entry = GetEntry();
+    if (IsSd() && m_menu->m_savestate_preview.Get() && m_entries.IsFile(selected_entry)) {
+        const auto ext = m_entries.GetInternalExtension(selected_entry);
+        if (IsExtension(ext, ROM_EXTENSIONS) || IsExtension(ext, ZIP_EXTENSIONS)) {
+            preview = m_preview_cache.Get(GetNewPathCurrent());
         }
+    }
+
+    if (preview != m_preview) {
+        if (m_preview_image) {
+            nvgDeleteImage(vg, m_preview_image);
+            m_preview_image = 0;
+        }
+
+        m_preview = preview;
+        if (m_preview) {
+            m_preview_image = nvgCreateImageRGBA(vg, m_preview->w, m_preview->h, 0, m_preview->thumbnail.data());
+        }
+    }
+
+    // counts, sizes and timestamps are loaded in UpdateMeta(), they are drawn once ready.
+    m_list->Draw(vg, theme, m_entries_current.size(), [this, text_col](auto* vg, auto* theme, auto v, auto i) {
+        const auto& [x, y, w, h] = v;
+        const auto e = GetEntry(i);
+        const auto is_dir = m_entries.IsDir(e);
 
         auto text_id = ThemeEntryID_TEXT;
         const auto selected = m_index == i;
@@ -203,11 +428,11 @@ void FsView::Draw(NVGcontext* vg, Theme* theme) {
             }
         }
 
-        if (e.IsDir()) {
+        if (is_dir) {
             DrawElement(x + text_xoffset, y + 5, 50, 50, ThemeEntryID_ICON_FOLDER);
         } else {
             auto icon = ThemeEntryID_ICON_FILE;
-            const auto ext = e.GetExtension();
+            const auto ext = m_entries.GetExtension(e);
             if (IsExtension(ext, ROM_EXTENSIONS)) {
                 icon = ThemeEntryID_ICON_NRO;
             } else if (IsExtension(ext, ZIP_EXTENSIONS)) {
@@ -217,33 +442,33 @@ void FsView::Draw(NVGcontext* vg, Theme* theme) {
             DrawElement(x + text_xoffset, y + 5, 50, 50, icon);
         }
 
-        m_scroll_name.Draw(vg, selected, x + text_xoffset+65, y + (h / 2.f), w-(75+text_xoffset+65+50), 20, NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE, theme->GetColour(text_id), e.name);
+        auto name_w = w-(75+text_xoffset+65+50);
+        if (selected && !is_dir && m_preview) {
+            DrawSaveStatePreview(vg, theme, v, text_id);
+            name_w -= 320;
+        }
 
-        if (e.IsDir()) {
-            if (e.file_count != -1) {
-                gfx::drawTextArgs(vg, x + w - text_xoffset, y + (h / 2.f) - 3, 16.f, NVG_ALIGN_RIGHT | NVG_ALIGN_BOTTOM, theme->GetColour(text_id), "%zd files"_i18n.c_str(), e.file_count);
+        m_scroll_name.Draw(vg, selected, x + text_xoffset+65, y + (h / 2.f), name_w, 20, NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE, theme->GetColour(text_id), m_entries.GetName(e));
+
+        if (is_dir) {
+            if (const s64 file_count = m_entries.GetFileCount(e); file_count != -1) {
+                gfx::drawTextArgs(vg, x + w - text_xoffset, y + (h / 2.f) - 3, 16.f, NVG_ALIGN_RIGHT | NVG_ALIGN_BOTTOM, theme->GetColour(text_id), "%zd files"_i18n.c_str(), file_count);
             }
-            if (e.dir_count != -1) {
-                gfx::drawTextArgs(vg, x + w - text_xoffset, y + (h / 2.f) + 3, 16.f, NVG_ALIGN_RIGHT | NVG_ALIGN_TOP, theme->GetColour(text_id), "%zd dirs"_i18n.c_str(), e.dir_count);
+            if (const s64 dir_count = m_entries.GetDirCount(e); dir_count != -1) {
+                gfx::drawTextArgs(vg, x + w - text_xoffset, y + (h / 2.f) + 3, 16.f, NVG_ALIGN_RIGHT | NVG_ALIGN_TOP, theme->GetColour(text_id), "%zd dirs"_i18n.c_str(), dir_count);
             }
-        } else if (e.IsFile()) {
-            if (!e.time_stamp.is_valid) {
-                const auto path = GetNewPath(e);
-                if (m_fs->IsNative()) {
-                    m_fs->GetFileTimeStampRaw(path, &e.time_stamp);
-                } else {
-                    m_fs->FileGetSizeAndTimestamp(path, &e.time_stamp, &e.file_size);
-                }
+        } else {
+            if (m_entries.HasTimeStamp(e)) {
+                const auto t = (time_t)(m_entries.GetModified(e));
+                struct tm tm{};
+                localtime_r(&t, &tm);
+                gfx::drawTextArgs(vg, x + w - text_xoffset, y + (h / 2.f) + 3, 16.f, NVG_ALIGN_RIGHT | NVG_ALIGN_TOP, theme->GetColour(text_id), "%02u/%02u/%u", tm.tm_mday, tm.tm_mon + 1, tm.tm_year + 1900);
             }
-
-            const auto t = (time_t)(e.time_stamp.modified);
-            struct tm tm{};
-            localtime_r(&t, &tm);
-            gfx::drawTextArgs(vg, x + w - text_xoffset, y + (h / 2.f) + 3, 16.f, NVG_ALIGN_RIGHT | NVG_ALIGN_TOP, theme->GetColour(text_id), "%02u/%02u/%u", tm.tm_mday, tm.tm_mon + 1, tm.tm_year + 1900);
-            if ((double)e.file_size / 1024.0 / 1024.0 <= 0.009) {
-                gfx::drawTextArgs(vg, x + w - text_xoffset, y + (h / 2.f) - 3, 16.f, NVG_ALIGN_RIGHT | NVG_ALIGN_BOTTOM, theme->GetColour(text_id), "%.2f KiB", (double)e.file_size / 1024.0);
+            const auto file_size = (double)m_entries.GetFileSize(e);
+            if (file_size / 1024.0 / 1024.0 <= 0.009) {
+                gfx::drawTextArgs(vg, x + w - text_xoffset, y + (h / 2.f) - 3, 16.f, NVG_ALIGN_RIGHT | NVG_ALIGN_BOTTOM, theme->GetColour(text_id), "%.2f KiB", file_size / 1024.0);
             } else {
-                gfx::drawTextArgs(vg, x + w - text_xoffset, y + (h / 2.f) - 3, 16.f, NVG_ALIGN_RIGHT | NVG_ALIGN_BOTTOM, theme->GetColour(text_id), "%.2f MiB", (double)e.file_size / 1024.0 / 1024.0);
+                gfx::drawTextArgs(vg, x + w - text_xoffset, y + (h / 2.f) - 3, 16.f, NVG_ALIGN_RIGHT | NVG_ALIGN_BOTTOM, theme->GetColour(text_id), "%.2f MiB", file_size / 1024.0 / 1024.0);
             }
         }
     });
@@ -251,6 +476,9 @@ void FsView::Draw(NVGcontext* vg, Theme* theme) {
 
 void FsView::OnFocusGained() {
     Widget::OnFocusGained();
+    // a savestate may have been made whilst a game was open.
+    m_preview_cache.Invalidate();
+
     if (m_entries.empty()) {
         if (m_path.empty()) {
             Scan(m_fs->Root());
@@ -258,15 +486,33 @@ void FsView::OnFocusGained() {
             Scan(m_path);
         }
 
-        if (IsSd() && !m_entries.empty()) {
+        if (IsSd()) {
             LastFile last_file{};
             if (ini_gets("paths", "last_file", "", last_file.name, sizeof(last_file.name), App::CONFIG_PATH)) {
-                SetIndexFromLastFile(last_file);
+                RestoreLastFile(last_file);
             }
         }
     }
 }
 
+void FsView::DrawSaveStatePreview(NVGcontext* vg, Theme* theme, const Vec4& v, ThemeEntryID text_id) {
+    const auto& [x, y, w, h] = v;
+
+    // leave room for the size and date on the right.
+    const float ih = h - 12.f;
+    const float iw = ih * m_preview->w / m_preview->h;
+    const float ix = x + w - 150.f - iw;
+    const float iy = y + 6.f;
+
+    gfx::drawImage(vg, ix, iy, iw, ih, m_preview_image);
+
+    const auto t = (time_t)(m_preview->timestamp);
+    struct tm tm{};
+    localtime_r(&t, &tm);
+    gfx::drawTextArgs(vg, ix - 10.f, y + (h / 2.f) - 3, 16.f, NVG_ALIGN_RIGHT | NVG_ALIGN_BOTTOM, theme->GetColour(text_id), "%s", "Savestate"_i18n.c_str());
+    gfx::drawTextArgs(vg, ix - 10.f, y + (h / 2.f) + 3, 16.f, NVG_ALIGN_RIGHT | NVG_ALIGN_TOP, theme->GetColour(text_id), "%02u/%02u/%u %02u:%02u", tm.tm_mday, tm.tm_mon + 1, tm.tm_year + 1900, tm.tm_hour, tm.tm_min);
+}
+
 void FsView::SetSide(ViewSide side) {
     m_side = side;
 
@@ -287,41 +533,59 @@ void FsView::SetIndex(s64 index) {
         m_list->SetYoff();
     }
 
-    if (!m_entries_current.empty() && !GetEntry().checked_internal_extension && GetEntry().GetExtension() == "zip") {
-        GetEntry().checked_internal_extension = true;
-
-        TimeStamp ts;
-        fs::FsPath filename_inzip{};
-        if (R_SUCCEEDED(mz::PeekFirstFileName(GetFs(), GetNewPathCurrent(), filename_inzip))) {
-            if (auto ext = std::strrchr(filename_inzip, '.')) {
-                GetEntry().internal_name = filename_inzip.toString();
-                GetEntry().internal_extension = ext+1;
-            }
-            log_write("\tzip, time taken: %.2fs %zums\n", ts.GetSecondsD(), ts.GetMs());
-        }
-    }
-
     m_menu->UpdateSubheading();
 }
 
-auto FsView::Scan(const fs::FsPath& new_path, bool is_walk_up) -> Result {
-    TimeStamp ts;
-    ON_SCOPE_EXIT(log_write("\tscan final, time taken: %.2fs %zums\n", ts.GetSecondsD(), ts.GetMs()));
-
-    App::SetBoostMode(true);
-    ON_SCOPE_EXIT(App::SetBoostMode(false));
-
+auto FsView::Scan(const fs::FsPath& new_path, bool is_walk_up, bool use_cache) -> Result {
     log_write("new scan path: %s\n", new_path.s);
+    SaveDirCache();
+
     if (!is_walk_up && !m_path.empty() && !m_entries_current.empty()) {
-        const LastFile f(GetEntry().name, m_index, m_list->GetYoff(), m_entries_current.size());
+        const LastFile f(GetEntryName(), m_index, m_list->GetYoff(), m_entries_current.size());
         m_previous_highlighted_file.emplace_back(f);
     }
 
     m_path = new_path;
-    m_entries.clear();
+    m_dir_mtime = 0;
+    m_dir_count = 0;
+    m_dir_cache_dirty = false;
+    m_entries.Clear();
+    m_entries_index.clear();
+    m_entries_index_hidden.clear();
+    m_entries_index_search.clear();
+    m_entries_current = {};
+    m_search_index.Clear();
+    m_search_query.clear();
+    m_preview_cache.Clear();
+    m_meta_loader.Reset(m_fs.get());
+    m_meta_window.clear();
     m_index = 0;
     m_list->SetYoff(0);
     m_menu->SetTitleSubHeading(m_path);
+    m_menu->UpdateSubheading();
+
+    // find previous entry
+    m_scan_last_file.reset();
+    if (is_walk_up && !m_previous_highlighted_file.empty()) {
+        m_scan_last_file = m_previous_highlighted_file.back();
+        m_previous_highlighted_file.pop_back();
+    }
+
+    if (m_scanner.IsRunning()) {
+        // the boost is removed once the scan finishes, see UpdateScan().
+        if (!m_scanner.IsScanning()) {
+            App::SetBoostMode(true);
+        }
+        // only the sd card is cached, other fs may be mounted at the same path.
+        m_scanner.Start(m_fs.get(), new_path, use_cache && IsSd());
+        R_SUCCEED();
+    }
+
+    TimeStamp ts;
+    ON_SCOPE_EXIT(log_write("\tscan final, time taken: %.2fs %zums\n", ts.GetSecondsD(), ts.GetMs()));
+
+    App::SetBoostMode(true);
+    ON_SCOPE_EXIT(App::SetBoostMode(false));
 
     fs::Dir d;
     R_TRY(m_fs->OpenDirectory(new_path, FsDirOpenMode_ReadDirs | FsDirOpenMode_ReadFiles, &d));
@@ -330,134 +594,421 @@ auto FsView::Scan(const fs::FsPath& new_path, bool is_walk_up) -> Result {
     std::vector<FsDirectoryEntry> dir_entries;
     R_TRY(d.ReadAll(dir_entries));
 
-    const auto count = dir_entries.size();
-    m_entries.reserve(count);
+    std::vector<DirCacheEntry> entries(dir_entries.size());
+    for (size_t i = 0; i < dir_entries.size(); i++) {
+        entries[i].name = dir_entries[i].name;
+        entries[i].type = dir_entries[i].type;
+        entries[i].file_size = dir_entries[i].file_size;
+    }
 
-    m_entries_index.clear();
-    m_entries_index_hidden.clear();
-    m_entries_index_search.clear();
+    AddEntries(entries, true);
+    R_SUCCEED();
+}
+
+void FsView::UpdateScan() {
+    if (!m_scanner.IsScanning()) {
+        return;
+    }
+
+    std::vector<DirCacheEntry> dir_entries;
+    DirScanResult result{};
+    const auto done = m_scanner.Poll(dir_entries, result);
+    if (!dir_entries.empty() || done) {
+        AddEntries(dir_entries, done);
+    }
+
+    if (done) {
+        App::SetBoostMode(false);
+        if (R_FAILED(result.rc)) {
+            log_write("failed to scan: %s 0x%X\n", m_path.s, result.rc);
+        } else if (IsSd()) {
+            m_dir_mtime = result.mtime;
+            m_dir_count = result.count;
+            m_dir_cache_dirty |= !result.cached;
+        }
+    }
+}
+
+void FsView::AddEntries(std::span<const DirCacheEntry> dir_entries, bool done) {
+    const auto shown = m_entries_current.size();
 
-    m_entries_index.reserve(count);
-    m_entries_index_hidden.reserve(count);
+    // adding entries below can reallocate the vectors m_entries_current points
+    // into, so the highlighted entry is read before anything is added.
+    // entries are only appended, so its id stays valid.
+    const auto selected_id = shown ? m_entries_current[m_index] : 0;
 
-    u32 i = 0;
+    size_t names_size{};
     for (const auto& e : dir_entries) {
-        if (e.type == FsDirEntryType_File) {
-            const auto ext = std::strrchr(e.name, '.');
+        names_size += e.name.length() + 1;
+    }
+
+    const auto count = m_entries.size() + dir_entries.size();
+    m_entries.Reserve(count, names_size);
+    ReserveGrow(m_entries_index, count);
+    ReserveGrow(m_entries_index_hidden, count);
+    m_search_index.Reserve(count);
+
+    for (const auto& e : dir_entries) {
+        const auto is_dir = e.type == FsDirEntryType_Dir;
+        if (!is_dir) {
+            const auto ext = std::strrchr(e.name.c_str(), '.');
             if (!ext || !IsExtension(ext + 1, FILTER_EXTENSIONS)) {
                 continue;
             }
         }
 
+        const auto i = m_entries.Add(e.name, is_dir, e.file_size);
+        if (e.time_stamp.is_valid) {
+            m_entries.SetModified(i, e.time_stamp.modified);
+        }
+        if (e.checked_internal) {
+            m_entries.SetCheckedInternal(i);
+        }
+        m_entries.SetInternalName(i, e.internal_name);
+
         m_entries_index_hidden.emplace_back(i);
 
-        if (e.name[0] != '.') {
+        if (!m_entries.IsHidden(i)) {
             m_entries_index.emplace_back(i);
         }
 
-        m_entries.emplace_back(e);
-        i++;
+        // ids match the index in m_entries.
+        m_search_index.Add(e.name);
     }
 
+    // sorting and searching the whole list for every chunk is quadratic over a
+    // large folder, so until the scan is done the new entries are only shown
+    // every SCAN_SORT_INTERVAL_MS. the shown rows are still sorted at the
+    // front of the list, new entries were appended after them.
+    if (!done && shown && m_scan_sort_ts.GetMs() < SCAN_SORT_INTERVAL_MS) {
+        m_entries_current = std::span{GetEntriesSource()}.first(shown);
+        return;
+    }
+    m_scan_sort_ts.Update();
+
+    // the highlighted row is kept whilst entries are added.
+    std::optional<LastFile> selected;
+    if (shown) {
+        selected = LastFile(m_entries.GetName(selected_id), m_index, m_list->GetYoff(), shown);
+    }
+
+    if (IsSearching()) {
+        UpdateSearch();
+    }
     Sort();
 
-    SetIndex(0);
+    if (m_scan_last_file.has_value() && (done || FindEntry(m_scan_last_file->name) >= 0)) {
+        SetIndexFromLastFile(*m_scan_last_file);
+        m_scan_last_file.reset();
+    } else if (selected.has_value()) {
+        if (!m_entries_current.empty() && !std::strcmp(GetEntryName(), selected->name)) {
+            m_menu->UpdateSubheading();
+        } else {
+            SetIndexFromLastFile(*selected);
+        }
+    } else {
+        SetIndex(0);
+    }
+}
 
-    // find previous entry
-    if (is_walk_up && !m_previous_highlighted_file.empty()) {
-        ON_SCOPE_EXIT(m_previous_highlighted_file.pop_back());
-        SetIndexFromLastFile(m_previous_highlighted_file.back());
+void FsView::UpdateMeta() {
+    std::vector<DirMetaResult> results;
+    m_meta_loader.Poll(results);
+    for (const auto& result : results) {
+        ApplyMeta(result);
     }
 
-    R_SUCCEED();
+    // visible rows first, then the rows that would be scrolled to next.
+    const s64 count = m_entries_current.size();
+    const s64 first = m_list->GetYoff() / m_list->GetMaxY();
+    const s64 page = m_list->GetPage();
+
+    std::vector<u32> window;
+    const auto add_rows = [this, count, &window](s64 start, s64 end) {
+        for (s64 i = std::max<s64>(start, 0); i < std::min(end, count); i++) {
+            window.emplace_back(m_entries_current[i]);
+        }
+    };
+
+    add_rows(first, first + page);
+    add_rows(first + page, first + page + META_PREFETCH_ROWS);
+    add_rows(first - META_PREFETCH_ROWS, first);
+
+    if (window == m_meta_window) {
+        return;
+    }
+    m_meta_window = window;
+
+    std::vector<DirMetaRequest> requests;
+    for (const auto index : window) {
+        if (m_entries.IsDir(index)) {
+            if (m_entries.GetFileCount(index) == -1 && m_entries.GetDirCount(index) == -1) {
+                requests.emplace_back(index, true, GetEntryPath(index));
+            }
+        } else {
+            // the dir cache is only checked against the mtime of the folder, which
+            // does not change when a file is overwritten, so cached rows are checked
+            // against the file once they are shown.
+            const auto load_size = m_entries.HasTimeStamp(index) && !m_entries.IsVerified(index);
+            const auto load_time_stamp = !m_entries.HasTimeStamp(index) || load_size;
+            const auto load_internal = NeedsInternalName(index);
+            if (load_time_stamp || load_internal) {
+                requests.emplace_back(index, false, GetEntryPath(index), load_time_stamp, load_internal, load_size);
+            }
+        }
+    }
+
+    if (m_meta_loader.IsRunning()) {
+        m_meta_loader.Request(std::move(requests));
+    } else {
+        for (const auto& request : requests) {
+            ApplyMeta(DirMetaLoader::Load(m_fs.get(), request));
+        }
+    }
+}
+
+void FsView::ApplyMeta(const DirMetaResult& result) {
+    const auto i = result.index;
+    if (result.is_dir) {
+        m_entries.SetCounts(i, result.file_count, result.dir_count);
+        return;
+    }
+
+    if (result.time_stamp.is_valid) {
+        if (!m_entries.HasTimeStamp(i)) {
+            m_dir_cache_dirty = true;
+        } else if (m_entries.GetModified(i) != result.time_stamp.modified || (result.file_size >= 0 && m_entries.GetFileSize(i) != result.file_size)) {
+            log_write("[dir cache] file changed: %s\n", m_entries.GetName(i));
+            m_entries.ClearInternalName(i);
+            // request the inner name again.
+            m_meta_window.clear();
+            m_dir_cache_dirty = true;
+        }
+
+        m_entries.SetModified(i, result.time_stamp.modified);
+        m_entries.SetVerified(i);
+    }
+
+    if (result.file_size >= 0) {
+        m_entries.SetFileSize(i, result.file_size);
+    }
+
+    // the entry may have been requested again before the result arrived.
+    if (result.checked_internal && !m_entries.IsCheckedInternal(i)) {
+        m_entries.SetCheckedInternal(i);
+        m_entries.SetInternalName(i, result.internal_name);
+        m_dir_cache_dirty = true;
+    }
+}
+
+auto FsView::NeedsInternalName(u32 entry) const -> bool {
+    return !m_entries.IsCheckedInternal(entry) && IsExtension(m_entries.GetExtension(entry), ZIP_EXTENSIONS);
+}
+
+void FsView::SaveDirCache() {
+    if (!m_dir_mtime || !m_dir_cache_dirty || m_scanner.IsScanning()) {
+        return;
+    }
+
+    DirCache cache;
+    cache.path = m_path;
+    cache.mtime = m_dir_mtime;
+    cache.count = m_dir_count;
+    cache.entries.resize(m_entries.size());
+    for (u32 i = 0; i < m_entries.size(); i++) {
+        auto& out = cache.entries[i];
+        out.name = m_entries.GetName(i);
+        out.type = m_entries.IsDir(i) ? FsDirEntryType_Dir : FsDirEntryType_File;
+        out.file_size = m_entries.GetFileSize(i);
+        out.time_stamp.is_valid = m_entries.HasTimeStamp(i);
+        out.time_stamp.modified = m_entries.GetModified(i);
+        if (m_entries.HasInternalName(i)) {
+            out.internal_name = m_entries.GetInternalName(i);
+        }
+        out.checked_internal = m_entries.IsCheckedInternal(i);
+    }
+
+    m_scanner.Save(std::move(cache));
+    m_dir_cache_dirty = false;
 }
 
 void FsView::Sort() {
-    // returns true if lhs should be before rhs
     const auto sort = m_menu->m_sort.Get();
     const auto order = m_menu->m_order.Get();
     const auto folders_first = m_menu->m_folders_first.Get();
     const auto hidden_last = m_menu->m_hidden_last.Get();
+    const auto& e = m_entries;
 
-    const auto sorter = [this, sort, order, folders_first, hidden_last](u32 _lhs, u32 _rhs) -> bool {
-        const auto& lhs = m_entries[_lhs];
-        const auto& rhs = m_entries[_rhs];
+    m_entries_current = GetEntriesSource();
 
-        if (hidden_last) {
-            if (lhs.IsHidden() && !rhs.IsHidden()) {
-                return false;
-            } else if (!lhs.IsHidden() && rhs.IsHidden()) {
-                return true;
-            }
-        }
+    // the list is sorted smallest / a-z first, then reversed for the other order.
+    // descending sorts names a-z, see the order option.
+    const auto reverse = sort == SortType_Size ? order == OrderType_Descending : order == OrderType_Ascending;
 
-        if (folders_first) {
-            if (lhs.type == FsDirEntryType_Dir && !(rhs.type == FsDirEntryType_Dir)) { // left is folder
-                return true;
-            } else if (!(lhs.type == FsDirEntryType_Dir) && rhs.type == FsDirEntryType_Dir) { // right is folder
-                return false;
-            }
-        }
+    const auto get_key = [&e, sort](u32 i) -> u64 {
+        return sort == SortType_Size ? e.GetFileSize(i) : e.GetNameKey(i);
+    };
 
-        switch (sort) {
-            case SortType_Size: {
-                if (lhs.file_size == rhs.file_size) {
-                    return strncasecmp(lhs.name, rhs.name, sizeof(lhs.name)) < 0;
-                } else if (order == OrderType_Descending) {
-                    return lhs.file_size > rhs.file_size;
-                } else {
-                    return lhs.file_size < rhs.file_size;
-                }
-            } break;
-            case SortType_Alphabetical: {
-                if (order == OrderType_Descending) {
-                    return strncasecmp(lhs.name, rhs.name, sizeof(lhs.name)) < 0;
-                } else {
-                    return strncasecmp(lhs.name, rhs.name, sizeof(lhs.name)) > 0;
-                }
-            } break;
-        }
+    // files of the same size are listed a-z in either order.
+    const auto tie_sorter = [&e, sort, reverse](u32 lhs, u32 rhs) -> bool {
+        const auto r = strcasecmp(e.GetName(lhs), e.GetName(rhs));
+        return sort == SortType_Size && reverse ? r > 0 : r < 0;
+    };
 
-        std::unreachable();
+    const auto key_equal = [&get_key](u32 lhs, u32 rhs) {
+        return get_key(lhs) == get_key(rhs);
     };
 
-    if (m_menu->m_show_hidden.Get()) {
-        m_entries_current = m_entries_index_hidden;
+    if (m_entries_current.size() < RADIX_SORT_MIN) {
+        std::sort(m_entries_current.begin(), m_entries_current.end(), [&get_key, &tie_sorter](u32 lhs, u32 rhs) {
+            const auto l = get_key(lhs);
+            const auto r = get_key(rhs);
+            return l != r ? l < r : tie_sorter(lhs, rhs);
+        });
     } else {
-        m_entries_current = m_entries_index;
+        RadixSort(m_entries_current, get_key);
+        ForEachRun(m_entries_current, key_equal, [&tie_sorter](std::span<u32> run) {
+            std::sort(run.begin(), run.end(), tie_sorter);
+        });
+    }
+
+    if (reverse) {
+        std::reverse(m_entries_current.begin(), m_entries_current.end());
+    }
+
+    // the order within each group is kept.
+    if (folders_first) {
+        std::stable_partition(m_entries_current.begin(), m_entries_current.end(), [&e](u32 i) {
+            return e.IsDir(i);
+        });
     }
 
-    std::sort(m_entries_current.begin(), m_entries_current.end(), sorter);
+    if (hidden_last) {
+        std::stable_partition(m_entries_current.begin(), m_entries_current.end(), [&e](u32 i) {
+            return !e.IsHidden(i);
+        });
+    }
+
+    m_sorted_order = order;
+}
+
+auto FsView::GetEntriesSource() -> std::vector<u32>& {
+    if (IsSearching()) {
+        return m_entries_index_search;
+    } else if (m_menu->m_show_hidden.Get()) {
+        return m_entries_index_hidden;
+    } else {
+        return m_entries_index;
+    }
+}
+
+void FsView::ReverseOrder() {
+    const auto order = m_menu->m_order.Get();
+    if (m_sorted_order == order) {
+        return;
+    }
+
+    const auto sort = m_menu->m_sort.Get();
+    const auto folders_first = m_menu->m_folders_first.Get();
+    const auto hidden_last = m_menu->m_hidden_last.Get();
+    const auto& e = m_entries;
+
+    std::optional<LastFile> last_file;
+    if (!m_path.empty() && !m_entries_current.empty()) {
+        last_file = LastFile(GetEntryName(), m_index, m_list->GetYoff(), m_entries_current.size());
+    }
+
+    const auto same_group = [&e, folders_first, hidden_last](u32 lhs, u32 rhs) {
+        return (!hidden_last || e.IsHidden(lhs) == e.IsHidden(rhs)) && (!folders_first || e.IsDir(lhs) == e.IsDir(rhs));
+    };
+
+    ForEachRun(m_entries_current, same_group, [](std::span<u32> run) {
+        std::reverse(run.begin(), run.end());
+    });
+
+    // files of the same size stay a-z.
+    if (sort == SortType_Size) {
+        const auto same_size = [&e, &same_group](u32 lhs, u32 rhs) {
+            return same_group(lhs, rhs) && e.GetFileSize(lhs) == e.GetFileSize(rhs);
+        };
+
+        ForEachRun(m_entries_current, same_size, [](std::span<u32> run) {
+            std::reverse(run.begin(), run.end());
+        });
+    }
+
+    m_sorted_order = order;
+
+    if (last_file.has_value()) {
+        RestoreLastFile(*last_file);
+    }
+}
+
+void FsView::Search(const std::string& query) {
+    if (query.empty()) {
+        ClearSearch();
+        return;
+    }
+
+    TimeStamp ts;
+    m_search_query = query;
+    UpdateSearch();
+    Sort();
+    m_list->SetYoff(0);
+    SetIndex(0);
+    m_menu->SetTitleSubHeading(m_path.toString() + " | " + "Search: "_i18n + m_search_query);
+    log_write("[search] %s found: %zu time taken: %zums\n", m_search_query.c_str(), m_entries_index_search.size(), ts.GetMs());
+}
+
+void FsView::ClearSearch() {
+    std::optional<LastFile> last_file;
+    if (!m_entries_current.empty()) {
+        last_file = LastFile(GetEntryName(), m_index, m_list->GetYoff(), m_entries_current.size());
+    }
+
+    m_search_query.clear();
+    m_entries_index_search.clear();
+    Sort();
+    m_menu->SetTitleSubHeading(m_path);
+
+    if (last_file.has_value()) {
+        SetIndexFromLastFile(*last_file);
+    } else {
+        SetIndex(0);
+    }
+}
+
+void FsView::UpdateSearch() {
+    m_entries_index_search = m_search_index.Search(m_search_query);
+
+    if (!m_menu->m_show_hidden.Get()) {
+        std::erase_if(m_entries_index_search, [this](u32 i) {
+            return m_entries.IsHidden(i);
+        });
+    }
 }
 
 void FsView::SortAndFindLastFile(bool scan) {
     std::optional<LastFile> last_file;
     if (!m_path.empty() && !m_entries_current.empty()) {
-        last_file = LastFile(GetEntry().name, m_index, m_list->GetYoff(), m_entries_current.size());
+        last_file = LastFile(GetEntryName(), m_index, m_list->GetYoff(), m_entries_current.size());
     }
 
     if (scan) {
-        Scan(m_path);
+        Scan(m_path, false, false);
     } else {
         Sort();
     }
 
     if (last_file.has_value()) {
-        SetIndexFromLastFile(*last_file);
+        RestoreLastFile(*last_file);
     }
 }
 
 void FsView::SetIndexFromLastFile(const LastFile& last_file) {
     SetIndex(0);
 
-    s64 index = -1;
-    for (u64 i = 0; i < m_entries_current.size(); i++) {
-        if (last_file.name == GetEntry(i).name) {
-            log_write("found name\n");
-            index = i;
-            break;
-        }
-    }
+    const auto index = FindEntry(last_file.name);
     if (index >= 0) {
         if (index == last_file.index && m_entries_current.size() == last_file.entries_count) {
             m_list->SetYoff(last_file.offset);
@@ -476,6 +1027,23 @@ void FsView::SetIndexFromLastFile(const LastFile& last_file) {
     }
 }
 
+void FsView::RestoreLastFile(const LastFile& last_file) {
+    if (m_scanner.IsScanning()) {
+        m_scan_last_file = last_file;
+    } else {
+        SetIndexFromLastFile(last_file);
+    }
+}
+
+auto FsView::FindEntry(const char* name) const -> s64 {
+    for (u64 i = 0; i < m_entries_current.size(); i++) {
+        if (!std::strcmp(name, m_entries.GetName(GetEntry(i)))) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 auto FsView::get_collection(fs::Fs* fs, const fs::FsPath& path, const fs::FsPath& parent_name, FsDirCollection& out, bool inc_file, bool inc_dir, bool inc_size) -> Result {
     out.path = path;
     out.parent_name = parent_name;
@@ -566,13 +1134,33 @@ void FsView::SetFs(const fs::FsPath& new_path, const FsEntry& new_entry) {
         return;
     }
 
+    // the scan and meta loader may still be reading with the old fs.
+    SaveDirCache();
+    if (m_meta_loader.IsRunning()) {
+        m_meta_loader.Exit();
+        if (R_FAILED(m_meta_loader.Init())) {
+            log_write("failed to create meta thread, loading on the main thread\n");
+        }
+    }
+    if (m_scanner.IsRunning()) {
+        if (m_scanner.IsScanning()) {
+            App::SetBoostMode(false);
+        }
+        m_scanner.Exit();
+        if (R_FAILED(m_scanner.Init())) {
+            log_write("failed to create scan thread, scanning on the main thread\n");
+        }
+    }
+
     // m_fs.reset();
     m_path = new_path;
-    m_entries.clear();
+    m_entries.Clear();
     m_entries_index.clear();
     m_entries_index_hidden.clear();
     m_entries_index_search.clear();
     m_entries_current = {};
+    m_search_index.Clear();
+    m_search_query.clear();
     m_previous_highlighted_file.clear();
     m_fs_entry = new_entry;
 
@@ -613,7 +1201,7 @@ void FsView::DisplayOptions() {
 
     options->Add<SidebarEntryArray>("Order"_i18n, order_items, [this](s64& index_out){
         m_menu->m_order.Set(index_out);
-        SortAndFindLastFile();
+        ReverseOrder();
     }, m_menu->m_order.Get());
 
     options->Add<SidebarEntryBool>("Show Hidden"_i18n, m_menu->m_show_hidden.Get(), [this](bool& v_out){
@@ -630,6 +1218,48 @@ void FsView::DisplayOptions() {
         m_menu->m_hidden_last.Set(v_out);
         SortAndFindLastFile();
     });
+
+    options->Add<SidebarEntryCallback>("Refresh"_i18n, [this](){
+        SortAndFindLastFile(true);
+    }, true,
+        "Reads the folder again instead of using the cached listing."_i18n
+    );
+
+    options->Add<SidebarEntryBool>("Savestate Preview"_i18n, m_menu->m_savestate_preview.Get(), [this](bool& v_out){
+        m_menu->m_savestate_preview.Set(v_out);
+    });
+
+    if (IsSd()) {
+        options->Add<SidebarEntryCallback>("Add folder to library"_i18n, [this](){
+            for (const auto& root : m_menu->GetLibraryRoots()) {
+                if (root == m_path) {
+                    App::Notify("Folder is already in the library"_i18n);
+                    return;
+                }
+            }
+
+            auto roots = m_menu->m_library_roots.Get();
+            if (!roots.empty()) {
+                roots += ';';
+            }
+            m_menu->m_library_roots.Set(roots + m_path.toString());
+            m_menu->RescanLibrary(true);
+        }, true,
+            "Adds this folder and its sub folders to the rom library."_i18n
+        );
+    }
+
+    options->Add<SidebarEntryCallback>("Search library"_i18n, [this](){
+        m_menu->SearchLibrary();
+    }, true,
+        "Searches the names of every rom in the library folders."_i18n
+    );
+
+    options->Add<SidebarEntryCallback>("Rescan library"_i18n, [this](){
+        m_menu->RescanLibrary(true);
+    }, true,
+        "Indexes new and changed roms in the library folders, set with library_roots in the config."_i18n
+    );
 }
 
 Menu::Menu(u32 flags) : MenuBase{"Rom Loader"_i18n, flags} {
@@ -641,6 +1271,12 @@ Menu::Menu(u32 flags) : MenuBase{"Rom Loader"_i18n, flags} {
 
     view = std::make_unique<FsView>(this, ViewSide::Left);
     ueventCreate(&g_change_uevent, true);
+
+    // only roms that changed since the last time are read.
+    if (R_FAILED(m_library.Init())) {
+        log_write("failed to create library thread\n");
+    }
+    RescanLibrary(false);
 }
 
 Menu::~Menu() {
@@ -651,6 +1287,13 @@ void Menu::Update(Controller* controller, TouchInfo* touch) {
         view->SortAndFindLastFile(true);
     }
 
+    UpdateLibraryIndex(LIBRARY_INDEX_PER_FRAME);
+
+    if (m_library_notify && !m_library.IsScanning()) {
+        m_library_notify = false;
+        App::Notify("Library: "_i18n + std::to_string(m_library.GetEntries()->size()) + " roms"_i18n);
+    }
+
     // workaround the buttons not being display properly.
     // basically, inherit all actions from the view, draw them,
     // then restore state after.
@@ -686,6 +1329,82 @@ void Menu::RefreshViews() {
     view->Scan(view->m_path);
 }
 
+auto Menu::GetLibraryRoots() -> std::vector<fs::FsPath> {
+    std::vector<fs::FsPath> roots;
+    const auto str = m_library_roots.Get();
+    for (const auto root : std::views::split(str, ';')) {
+        const std::string_view view{root.begin(), root.end()};
+        if (!view.empty() && view.length() < sizeof(fs::FsPath::s)) {
+            roots.emplace_back(std::string{view});
+        }
+    }
+    return roots;
+}
+
+void Menu::RescanLibrary(bool notify) {
+    m_library.Rescan(GetLibraryRoots());
+    m_library_notify = notify;
+}
+
+void Menu::UpdateLibraryIndex(size_t max_count) {
+    if (const auto generation = m_library.GetGeneration(); generation != m_library_generation) {
+        m_library_generation = generation;
+        m_library_entries = m_library.GetEntries();
+        m_library_index.Clear();
+        m_library_index.Reserve(m_library_entries->size());
+    }
+
+    if (!m_library_entries) {
+        return;
+    }
+
+    const auto& entries = *m_library_entries;
+    for (size_t i = 0; i < max_count && m_library_index.GetCount() < entries.size(); i++) {
+        const auto& path = entries[m_library_index.GetCount()].path;
+        m_library_index.Add(std::string_view{path}.substr(path.find_last_of('/') + 1));
+    }
+}
+
+void Menu::SearchLibrary() {
+    // finish the index now rather than showing partial results.
+    UpdateLibraryIndex(SIZE_MAX);
+    if (!m_library_entries || m_library_entries->empty()) {
+        App::Notify("Library is empty, add a folder to it first"_i18n);
+        return;
+    }
+
+    std::string query;
+    if (R_FAILED(swkbd::ShowText(query, "Search library"_i18n.c_str())) || query.empty()) {
+        return;
+    }
+
+    auto ids = m_library_index.Search(query);
+    if (ids.empty()) {
+        App::Notify("No results"_i18n);
+        return;
+    }
+
+    auto title = "Library: "_i18n + query + " (" + std::to_string(ids.size()) + ")";
+    if (ids.size() > LIBRARY_SEARCH_MAX_RESULTS) {
+        ids.resize(LIBRARY_SEARCH_MAX_RESULTS);
+        title += " " + "showing first "_i18n + std::to_string(LIBRARY_SEARCH_MAX_RESULTS);
+    }
+
+    PopupList::Items items;
+    std::vector<fs::FsPath> paths;
+    for (const auto id : ids) {
+        const auto& path = (*m_library_entries)[id].path;
+        items.emplace_back(path.substr(path.find_last_of('/') + 1));
+        paths.emplace_back(path);
+    }
+
+    App::Push<PopupList>(title, items, [paths](auto op_index){
+        if (op_index) {
+            App::Push<menu::emu::Menu>(paths[*op_index]);
+        }
+    });
+}
+
 void Menu::PromptIfShouldExit() {
     if (IsTab()) {
         return;